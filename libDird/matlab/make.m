@@ -2,6 +2,6 @@ dbclear all;
 
 % compile matlab wrappers
 disp('Building wrappers ...');
-mex dirdMex.cpp ../src/cDird.cpp CXXFLAGS="\$CXXFLAGS -O3 -msse3";
-mex placeRecognizerMex.cpp ../src/cDird.cpp ../src/cPlaceRecognizer.cpp CXXFLAGS="\$CXXFLAGS -O3 -msse3";
+mex dirdMex.cpp ../src/cDird.cpp ../src/cDownsampler.cpp ../src/cSadKernel.cpp CXXFLAGS="\$CXXFLAGS -O3 -msse3";
+mex placeRecognizerMex.cpp ../src/cDird.cpp ../src/cDownsampler.cpp ../src/cPlaceRecognizer.cpp ../src/cSadKernel.cpp ../src/cVpTree.cpp CXXFLAGS="\$CXXFLAGS -O3 -msse3 -fopenmp" LDFLAGS="\$LDFLAGS -fopenmp";
 disp('...done!');
@@ -8,6 +8,25 @@
 
 using namespace std;
 typedef unsigned char uint8_t;
+
+// the entries of a sparse matrix row by row as columns (i,j,value) of a 3xN matrix
+static mxArray * toMxArray( const DIRD::cPlaceRecognizer::tSparseMatrix & matrix )
+{
+  const int32_t DIMS[] = {3, (int32_t)matrix.size()};
+  mxArray * array = mxCreateNumericArray(2,DIMS,mxDOUBLE_CLASS,mxREAL);
+  double* loops_out = (double*)mxGetPr(array);
+  int k = 0;
+  for (int i = 0; i < matrix.size_; ++i)
+  {
+    for (const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry = matrix.rowBegin(i); entry != matrix.rowEnd(i); ++entry)
+    {
+      loops_out[k++] = i;
+      loops_out[k++] = entry->j;
+      loops_out[k++] = entry->value;
+    }
+  }
+  return array;
+}
     
 
 void mexFunction (int nlhs,mxArray *plhs[],int nrhs,const mxArray *prhs[]) 
@@ -28,7 +47,7 @@ void mexFunction (int nlhs,mxArray *plhs[],int nrhs,const mxArray *prhs[])
   const int *dims = mxGetDimensions(prhs[0]);
 
   static const int max_num_features = 100000; // adjust to your needs
-  static const int dim_feature = DIRD::cDird::iDim_ * 16 /* assuming a tiling of 4x4 */; 
+  static const int dim_feature = DIRD::cDird::iFrameDim_; 
   int num_features = dims[1];
 
   if(dim_feature != dims[0])
@@ -37,7 +56,7 @@ void mexFunction (int nlhs,mxArray *plhs[],int nrhs,const mxArray *prhs[])
   }
 
   // copy to sse memory
-  uint8_t * feature_vectors = (uint8_t*)_mm_malloc(sizeof(uint8_t) *  max_num_features * dim_feature, 16); 
+  uint8_t * feature_vectors = (uint8_t*)_mm_malloc(sizeof(uint8_t) * (size_t)max_num_features * dim_feature, 16); 
   memcpy( feature_vectors, input_data, sizeof(uint8_t) * dims[0] * dims[1] );
   
   // compute loop closures
@@ -60,59 +79,17 @@ void mexFunction (int nlhs,mxArray *plhs[],int nrhs,const mxArray *prhs[])
     
   if (nlhs >= 1)
   {
-    const int32_t DIMS[] = {3, place_recognizer.matLoopClosures_.size()};
-    plhs[0] = mxCreateNumericArray(2,DIMS,mxDOUBLE_CLASS,mxREAL);
-    double* loops_out = (double*)mxGetPr(plhs[0]);
-    int k = 0;
-    for (DIRD::cPlaceRecognizer::tSparseMatrixIterator iter = place_recognizer.matLoopClosures_.begin(); 
-        iter != place_recognizer.matLoopClosures_.end(); 
-        iter++)
-    {
-      // compute 2d index
-      int j = iter->first % place_recognizer.matLoopClosures_.size_;
-      int i = (iter->first - j) / place_recognizer.matLoopClosures_.size_;
-      loops_out[k++] = i;
-      loops_out[k++] = j;
-      loops_out[k++] = iter->second;
-    }
+    plhs[0] = toMxArray( place_recognizer.matLoopClosures_ );
   }
 
   if (nlhs >= 2)
   {
-    const int32_t DIMS[] = {3, place_recognizer.matDynamicProgramming_.size()};
-    plhs[1] = mxCreateNumericArray(2,DIMS,mxDOUBLE_CLASS,mxREAL);
-    double* loops_out = (double*)mxGetPr(plhs[1]);
-    int k = 0;
-    for (DIRD::cPlaceRecognizer::tSparseMatrixIterator iter = place_recognizer.matDynamicProgramming_.begin(); 
-        iter != place_recognizer.matDynamicProgramming_.end(); 
-        iter++)
-    {
-      // compute 2d index
-      int j = iter->first % place_recognizer.matDynamicProgramming_.size_;
-      int i = (iter->first - j) / place_recognizer.matDynamicProgramming_.size_;
-      loops_out[k++] = i;
-      loops_out[k++] = j;
-      loops_out[k++] = iter->second;
-    }
+    plhs[1] = toMxArray( place_recognizer.matDynamicProgramming_ );
   }
 
   if (nlhs >= 3)
   {
-    const int32_t DIMS[] = {3, place_recognizer.matSimilarity_.size()};
-    plhs[2] = mxCreateNumericArray(2,DIMS,mxDOUBLE_CLASS,mxREAL);
-    double* loops_out = (double*)mxGetPr(plhs[2]);
-    int k = 0;
-    for (DIRD::cPlaceRecognizer::tSparseMatrixIterator iter = place_recognizer.matSimilarity_.begin(); 
-        iter != place_recognizer.matSimilarity_.end(); 
-        iter++)
-    {
-      // compute 2d index
-      int j = iter->first % place_recognizer.matSimilarity_.size_;
-      int i = (iter->first - j) / place_recognizer.matSimilarity_.size_;
-      loops_out[k++] = i;
-      loops_out[k++] = j;
-      loops_out[k++] = iter->second;
-    }
+    plhs[2] = toMxArray( place_recognizer.matSimilarity_ );
   }
 
 }
@@ -0,0 +1,1281 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <sstream>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#if _MSC_VER <= 1500
+typedef unsigned char uint8_t;
+#else
+#include <stdint.h>
+#endif
+
+#ifdef _MSC_VER
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include "cDird.h"
+#include "cDownsampler.h"
+#include "cPlaceRecognizer.h"
+#include "cOnlinePlaceRecognizer.h"
+#include "cFeatureStore.h"
+
+using namespace std;
+
+/*
+ * Micro benchmarks of the computational hot spots of libDird. No input data
+ * is needed, synthetic feature vectors (a random walk through "places" which
+ * is traversed twice) are generated on the fly.
+ *
+ */
+
+// wall clock time in seconds
+static double getTime()
+{
+#ifdef _MSC_VER
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+  struct timeval TIME;
+  gettimeofday(&TIME, NULL);
+  return TIME.tv_sec + ((double) TIME.tv_usec)/1000000.0;
+#endif
+}
+
+// synthetic sequence of num_features feature vectors. The last 30% of the
+// frames revisit places seen before such that there are some loop closures.
+static uint8_t * createFeatures( int num_features, int dim_feature )
+{
+  uint8_t * feature_vectors = (uint8_t*)_mm_malloc(sizeof(uint8_t) * num_features * dim_feature, 64);
+
+  srand(4711);
+  vector<int> place( dim_feature, 100 );
+  vector<uint8_t> places( num_features * dim_feature );
+  for (int i = 0; i < num_features; ++i)
+  {
+    for (int d = 0; d < dim_feature; ++d)
+    {
+      place[d] = max( 40, min( 215, place[d] + rand() % 15 - 7 ) );
+      places[ i * dim_feature + d ] = (uint8_t)place[d];
+    }
+  }
+
+  int revisit = num_features * 7 / 10;
+  for (int i = 0; i < num_features; ++i)
+  {
+    int p = i < revisit ? i : num_features / 10 + (i - revisit) * 9 / 10;
+    for (int d = 0; d < dim_feature; ++d)
+    {
+      feature_vectors[ i * dim_feature + d ] = (uint8_t)( places[ p * dim_feature + d ] + rand() % 11 - 5 );
+    }
+  }
+
+  return feature_vectors;
+}
+
+// compares two sparse matrices entry by entry
+static bool isEqual( const DIRD::cPlaceRecognizer::tSparseMatrix & mat1, const DIRD::cPlaceRecognizer::tSparseMatrix & mat2 )
+{
+  if (mat1.size() != mat2.size() || mat1.vecRowOffsets_ != mat2.vecRowOffsets_)
+  {
+    return false;
+  }
+  for (size_t e = 0; e < mat1.size(); ++e)
+  {
+    if (mat1.vecEntries_[e].j != mat2.vecEntries_[e].j || mat1.vecEntries_[e].value != mat2.vecEntries_[e].value)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// the sparse matrix type used before cPlaceRecognizer::tSparseMatrix (a hash map
+// keyed by i*size+j), for the former implementations below
+struct tHashMatrix
+  : public unordered_map<long,float>
+{
+  tHashMatrix( int size )
+    : size_(size)
+  {
+  }
+
+  inline float & operator()( int i, int j )
+  {
+    return (*this)[ (long)i * size_ + j ];
+  }
+
+  inline float at( int i, int j )
+  {
+    iterator iter = find( (long)i * size_ + j );
+    return iter == end() ? 0.0f : iter->second;
+  }
+
+  int size_;
+};
+
+/*
+ * Throughput (pairs per second) of computePairwiseSimilarity() for growing
+ * numbers of feature vectors and all similarity engines.
+ */
+static int benchmarkSimilarity( const vector<int> & sizes )
+{
+  static const int dim_feature = DIRD::cDird::iDim_ * 16;
+  static const int safety_margin = 200;
+
+  cout << "N\tengine\tseconds\tpairs/s\n";
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_features = sizes[s];
+    uint8_t * feature_vectors = createFeatures( num_features, dim_feature );
+    double num_pairs = 0;
+    for (int i = 0; i + safety_margin < num_features; ++i)
+    {
+      num_pairs += num_features - i - safety_margin;
+    }
+
+    DIRD::cPlaceRecognizer reference( feature_vectors, num_features, dim_feature );
+    reference.similarityEngine_ = DIRD::cPlaceRecognizer::SIMILARITY_BRUTE_FORCE;
+
+    static const char * names[] = { "brute_force", "tiled", "early_exit", "cascade", "ann" };
+    for (int e = DIRD::cPlaceRecognizer::SIMILARITY_BRUTE_FORCE; e <= DIRD::cPlaceRecognizer::SIMILARITY_ANN; ++e)
+    {
+      DIRD::cPlaceRecognizer place_recognizer( feature_vectors, num_features, dim_feature );
+      place_recognizer.similarityEngine_ = (DIRD::cPlaceRecognizer::eSimilarityEngine)e;
+
+      double time_start = getTime();
+      place_recognizer.computePairwiseSimilarity( safety_margin );
+      double seconds = getTime() - time_start;
+
+      if (e == DIRD::cPlaceRecognizer::SIMILARITY_BRUTE_FORCE)
+      {
+        reference.matSimilarity_ = place_recognizer.matSimilarity_;
+      }
+      else if (!isEqual( reference.matSimilarity_, place_recognizer.matSimilarity_ ))
+      {
+        cerr << "Similarity engine " << names[e] << " differs from brute force result!\n";
+        return 1;
+      }
+
+      cout << num_features << "\t" << names[e] << "\t" << seconds << "\t" << num_pairs / seconds << "\n";
+    }
+
+    _mm_free( feature_vectors );
+  }
+
+  return 0;
+}
+
+/*
+ * Recall and speed of SIMILARITY_ANN for several pruning factors. Recall is
+ * the fraction of the entries of the exact matSimilarity_ that are found.
+ */
+static int benchmarkRecall( const vector<int> & sizes )
+{
+  static const int dim_feature = DIRD::cDird::iDim_ * 16;
+  static const int safety_margin = 200;
+  static const float pruning_factors[] = { 1.0f, 0.8f, 0.6f, 0.4f, 0.2f };
+
+  cout << "N\tpruning\tseconds\tdistances\trecall\n";
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_features = sizes[s];
+    uint8_t * feature_vectors = createFeatures( num_features, dim_feature );
+
+    DIRD::cPlaceRecognizer reference( feature_vectors, num_features, dim_feature );
+    double time_start = getTime();
+    reference.computePairwiseSimilarity( safety_margin );
+    double seconds = getTime() - time_start;
+    cout << num_features << "\texact\t" << seconds << "\t-\t1\n";
+
+    for (size_t p = 0; p < sizeof(pruning_factors) / sizeof(pruning_factors[0]); ++p)
+    {
+      DIRD::cPlaceRecognizer place_recognizer( feature_vectors, num_features, dim_feature );
+      place_recognizer.similarityEngine_ = DIRD::cPlaceRecognizer::SIMILARITY_ANN;
+      place_recognizer.annPruningFactor_ = pruning_factors[p];
+
+      time_start = getTime();
+      place_recognizer.computePairwiseSimilarity( safety_margin );
+      seconds = getTime() - time_start;
+
+      // every entry found must be exact, only missing entries are allowed
+      long num_found = 0;
+      const DIRD::cPlaceRecognizer::tSparseMatrix & found = place_recognizer.matSimilarity_;
+      for (int i = 0; i < num_features; ++i)
+      {
+        for (const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry = found.rowBegin(i); entry != found.rowEnd(i); ++entry)
+        {
+          if (reference.matSimilarity_.at( i, entry->j ) != entry->value)
+          {
+            cerr << "SIMILARITY_ANN found an entry which is not in the exact result!\n";
+            return 1;
+          }
+          num_found++;
+        }
+      }
+      if (pruning_factors[p] == 1.0f && !isEqual( reference.matSimilarity_, place_recognizer.matSimilarity_ ))
+      {
+        cerr << "SIMILARITY_ANN with pruning factor 1 differs from brute force result!\n";
+        return 1;
+      }
+
+      double recall = reference.matSimilarity_.size() > 0 ? (double)num_found / reference.matSimilarity_.size() : 1.0;
+      cout << num_features << "\t" << pruning_factors[p] << "\t" << seconds << "\t" 
+        << place_recognizer.numAnnDistances_ << "\t" << recall << "\n";
+    }
+
+    _mm_free( feature_vectors );
+  }
+
+  return 0;
+}
+
+// number of non-zero entries
+static int countLoops( const DIRD::cPlaceRecognizer::tSparseMatrix & mat )
+{
+  int num_loops = 0;
+  for (size_t e = 0; e < mat.size(); ++e)
+  {
+    if (mat.vecEntries_[e].value != 0)
+    {
+      num_loops++;
+    }
+  }
+  return num_loops;
+}
+
+/*
+ * Per-frame latency of cOnlinePlaceRecognizer. The segment scores and loop 
+ * closures computed online are compared to those of the batch cPlaceRecognizer.
+ */
+static int benchmarkOnline( const vector<int> & sizes )
+{
+  static const int dim_feature = DIRD::cDird::iDim_ * 16;
+  static const int safety_margin = 200;
+  static const int segment_length = 20;
+  static const int non_max = 60;
+
+  cout << "N\tmean latency [ms]\tmax latency [ms]\tlast latency [ms]\tloop closures\n";
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_features = sizes[s];
+    uint8_t * feature_vectors = createFeatures( num_features, dim_feature );
+
+    DIRD::cPlaceRecognizer reference( feature_vectors, num_features, dim_feature );
+    reference.computePairwiseSimilarity( safety_margin );
+    reference.postProcessSimilarities( segment_length );
+
+    DIRD::cOnlinePlaceRecognizer place_recognizer( dim_feature, safety_margin, segment_length, non_max );
+    vector<DIRD::cOnlinePlaceRecognizer::tLoopClosure> loop_closures;
+    size_t num_scores = 0;
+    for (int n = 0; n < num_features; ++n)
+    {
+      place_recognizer.addFrame( &feature_vectors[ n * dim_feature ], loop_closures );
+
+      const DIRD::cOnlinePlaceRecognizer::tColumn & scores = place_recognizer.dqDpColumns_.back();
+      for (size_t e = 0; e < scores.size(); ++e)
+      {
+        if (reference.matDynamicProgramming_.at( scores[e].i, n ) != scores[e].value)
+        {
+          cerr << "Online segment score (" << scores[e].i << "," << n << ") differs from batch result!\n";
+          return 1;
+        }
+      }
+      num_scores += scores.size();
+    }
+    place_recognizer.flush( loop_closures );
+    if (num_scores != reference.matDynamicProgramming_.size())
+    {
+      cerr << "Online and batch segment scores differ in number!\n";
+      return 1;
+    }
+
+    reference.computeLoops( non_max );
+    for (size_t l = 0; l < loop_closures.size(); ++l)
+    {
+      if (reference.matLoopClosures_.at( loop_closures[l].i, loop_closures[l].j ) != loop_closures[l].score)
+      {
+        cerr << "Online loop closure (" << loop_closures[l].i << "," << loop_closures[l].j << ") differs from batch result!\n";
+        return 1;
+      }
+    }
+    if ((int)loop_closures.size() != countLoops( reference.matLoopClosures_ ))
+    {
+      cerr << "Online and batch loop closures differ in number!\n";
+      return 1;
+    }
+
+    cout << num_features << "\t" << place_recognizer.latencySum_ / num_features * 1000.0 
+      << "\t" << place_recognizer.latencyMax_ * 1000.0 << "\t" << place_recognizer.latencyLast_ * 1000.0 
+      << "\t" << loop_closures.size() << "\n";
+
+    _mm_free( feature_vectors );
+  }
+
+  return 0;
+}
+
+// synthetic grey value image (smooth gradients plus noise)
+static uint8_t * createImage( int width, int height, int seed )
+{
+  uint8_t * img_data = (uint8_t*)_mm_malloc(sizeof(uint8_t) * width * height, 16);
+  srand(seed);
+  for (int v = 0; v < height; ++v)
+  {
+    for (int u = 0; u < width; ++u)
+    {
+      img_data[ v * width + u ] = (uint8_t)( (u * 3 + v * 5 + seed * 17) % 200 + rand() % 56 );
+    }
+  }
+  return img_data;
+}
+
+/*
+ * Per-frame runtime of cDird::process() (integral image and wavelet features)
+ * and cDird::get() (descriptors of the tile centres, as in compute_features)
+ * for a descriptor geometry (tDird), all instruction sets and memory layouts.
+ * The wavelet planes are compared to those of the scalar version, descriptors
+ * of the INTERLEAVED and FIXED_POINT layouts to those of the PLANAR layout.
+ */
+template <class tDird>
+static int benchmarkFeatures( const vector<int> & sizes, const char * geometry )
+{
+  static const int tile_size = tDird::tileSize_;
+  static const int num_tiles_x = tDird::numTilesX_;
+  static const int num_tiles_y = tDird::numTilesY_;
+  static const int num_tiles = num_tiles_x * num_tiles_y;
+  static const int width = tDird::iFrameWidth_;
+  static const int height = tDird::iFrameHeight_;
+  static const DIRD::cSadKernel::eInstructionSet instruction_sets[] = 
+  { 
+    DIRD::cSadKernel::SCALAR, DIRD::cSadKernel::SSE2, DIRD::cSadKernel::AVX2 
+  };
+  static const int num_instruction_sets = sizeof(instruction_sets) / sizeof(instruction_sets[0]);
+
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_frames = sizes[s];
+    vector<uint8_t*> images( num_frames );
+    for (int n = 0; n < num_frames; ++n)
+    {
+      images[n] = createImage( width, height, n );
+    }
+
+    // descriptors of all frames (planar, scalar)
+    vector<uint8_t> reference( num_frames * tDird::iFrameDim_ );
+    static const typename tDird::eLayout layouts[] = { tDird::PLANAR, tDird::INTERLEAVED, tDird::FIXED_POINT };
+    static const char * layout_names[] = { "planar", "interleaved", "fixed point" };
+    for (int k = 0; k < 6 * num_instruction_sets; ++k)
+    {
+      // all layouts, then all layouts with lazy evaluation
+      int l = (k / num_instruction_sets) % 3;
+      typename tDird::eLayout layout = layouts[l];
+      bool lazy = k >= 3 * num_instruction_sets;
+      DIRD::cSadKernel::eInstructionSet instruction_set = instruction_sets[ k % num_instruction_sets ];
+      if (instruction_set > DIRD::cSadKernel::detect())
+      {
+        continue;
+      }
+
+      tDird dird( width, height, layout );
+      dird.setInstructionSet( instruction_set );
+      for (int t = 0; t < num_tiles && lazy; ++t)
+      {
+        dird.addQueryPoint( (t / num_tiles_y) * tile_size + tile_size/2, (t % num_tiles_y) * tile_size + tile_size/2 );
+      }
+      int num_pixels = lazy ? dird.getFootprintSize() : width * height;
+      tDird planes( width, height, layout );
+      planes.setInstructionSet( DIRD::cSadKernel::SCALAR );
+
+      double time_process = 0;
+      double time_get = 0;
+      double time_grid = 0;
+      int num_differences = 0;
+      vector<uint8_t> feature_vector;
+      vector<uint8_t> frame_feature( tDird::iFrameDim_ );
+      vector<uint8_t> frame_feature_grid( tDird::iFrameDim_ );
+      for (int n = 0; n < num_frames; ++n)
+      {
+        double time_start = getTime();
+        dird.process( images[n] );
+        time_process += getTime() - time_start;
+
+        // one descriptor after the other ...
+        time_start = getTime();
+        for (int t = 0; t < num_tiles; ++t)
+        {
+          dird.get( (t / num_tiles_y) * tile_size + tile_size/2, (t % num_tiles_y) * tile_size + tile_size/2, feature_vector );
+          memcpy( &frame_feature[ t * tDird::iDim_ ], &feature_vector[0], tDird::iDim_ );
+        }
+        time_get += getTime() - time_start;
+
+        // ... or all at once
+        time_start = getTime();
+        dird.getGrid( &frame_feature_grid[0] );
+        time_grid += getTime() - time_start;
+        if (frame_feature_grid != frame_feature)
+        {
+          cerr << "Descriptors of getGrid() and get() differ!\n";
+          return 1;
+        }
+
+        uint8_t * expected = &reference[ n * frame_feature.size() ];
+        if (k == 0)
+        {
+          memcpy( expected, &frame_feature[0], frame_feature.size() );
+        }
+        for (size_t d = 0; d < frame_feature.size(); ++d)
+        {
+          num_differences += expected[d] != frame_feature[d];
+        }
+      }
+
+      // the planes of the last frame need to be identical to the scalar version
+      if (layout != tDird::INTERLEAVED && !lazy)
+      {
+        planes.process( images[ num_frames - 1 ] );
+        for (int d = 0; d < tDird::numLevels_ * 3; ++d)
+        {
+          bool equal = layout == tDird::PLANAR ? 
+            memcmp( dird.arrWaveletStack_[d], planes.arrWaveletStack_[d], sizeof(double) * width * height ) == 0 :
+            memcmp( dird.arrWaveletStackFixed_[d], planes.arrWaveletStackFixed_[d], sizeof(int16_t) * width * height ) == 0;
+          if (!equal || (layout == tDird::PLANAR && num_differences != 0))
+          {
+            cerr << "Wavelet planes of instruction set " << DIRD::cSadKernel::name( instruction_set ) 
+              << " differ from the scalar version!\n";
+            return 1;
+          }
+        }
+      }
+
+      if (layout == tDird::PLANAR && num_differences != 0)
+      {
+        cerr << "Descriptors of the lazy evaluation differ!\n";
+        return 1;
+      }
+
+      cout << geometry << "\t" << num_frames << "\t" << layout_names[l] << (lazy ? " lazy" : "") << "\t" 
+        << DIRD::cSadKernel::name( instruction_set ) << "\t" << num_pixels << "\t" << time_process / num_frames * 1000.0 
+        << "\t" << time_get / num_frames * 1000.0 << "\t" << time_grid / num_frames * 1000.0 << "\t" << num_differences << "\n";
+    }
+
+    for (int n = 0; n < num_frames; ++n)
+    {
+      _mm_free( images[n] );
+    }
+  }
+
+  return 0;
+}
+
+// the text parser used before cFeatureStore::parseTextFeature()
+static bool parseTextFeatureStream( const string & text, uint8_t * feature, int dim )
+{
+  istringstream iss( text );
+  for (int i = 0; i < dim; ++i)
+  {
+    string word;
+    iss >> word;
+    int v = atoi( word.c_str() );
+    if (v < 0 || v > 255 || !iss.good())
+    {
+      return false;
+    }
+    feature[i] = (uint8_t)v;
+  }
+  return true;
+}
+
+/*
+ * Throughput (MB/s) of parsing text feature files (as written by older versions
+ * of compute_features) in memory, i.e. without disk I/O.
+ */
+static int benchmarkParse( const vector<int> & sizes )
+{
+  static const int dim_feature = DIRD::cDird::iDim_ * 16;
+
+  cout << "N\tMB\tstream [MB/s]\tscanner [MB/s]\tspeedup\n";
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_features = sizes[s];
+    uint8_t * feature_vectors = createFeatures( num_features, dim_feature );
+
+    vector<string> texts( num_features );
+    double num_bytes = 0;
+    for (int i = 0; i < num_features; ++i)
+    {
+      ostringstream oss;
+      for (int d = 0; d < dim_feature; ++d)
+      {
+        oss << (int)feature_vectors[ i * dim_feature + d ] << " ";
+      }
+      texts[i] = oss.str();
+      num_bytes += texts[i].size();
+    }
+
+    vector<uint8_t> parsed( dim_feature );
+    double time_start = getTime();
+    for (int i = 0; i < num_features; ++i)
+    {
+      parseTextFeatureStream( texts[i], &parsed[0], dim_feature );
+    }
+    double time_stream = getTime() - time_start;
+
+    time_start = getTime();
+    for (int i = 0; i < num_features; ++i)
+    {
+      if (!DIRD::cFeatureStore::parseTextFeature( texts[i].c_str(), texts[i].size(), &parsed[0], dim_feature ) ||
+          memcmp( &parsed[0], &feature_vectors[ i * dim_feature ], dim_feature ) != 0)
+      {
+        cerr << "Parsed feature vector " << i << " differs from the original!\n";
+        return 1;
+      }
+    }
+    double time_scanner = getTime() - time_start;
+
+    cout << num_features << "\t" << num_bytes / 1e6 << "\t" << num_bytes / 1e6 / time_stream 
+      << "\t" << num_bytes / 1e6 / time_scanner << "\t" << time_stream / time_scanner << "\n";
+
+    _mm_free( feature_vectors );
+  }
+
+  return 0;
+}
+
+// the dynamic programming used before cPlaceRecognizer::dynamicProgrammingBand()
+// (a hash map of scores and a set of start indices per hypothesis)
+static void postProcessSimilaritiesSparse( DIRD::cPlaceRecognizer & place_recognizer, int segment_length, 
+    DIRD::cPlaceRecognizer::tSparseMatrix & result )
+{
+  float tau_3 = 0.05f;
+  float tau_2 = tau_3;
+  int num_features = place_recognizer.num_features_;
+  const DIRD::cPlaceRecognizer::tSparseMatrix & similarities = place_recognizer.matSimilarity_;
+
+  // the similarities in the former hash map (its order is the order of the hypotheses)
+  tHashMatrix similarity_map( num_features );
+  for (int i = 0; i < num_features; ++i)
+  {
+    for (const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry = similarities.rowBegin(i); entry != similarities.rowEnd(i); ++entry)
+    {
+      similarity_map( i, entry->j ) = entry->value;
+    }
+  }
+
+  set<int> startIndicies;
+  tHashMatrix DP( num_features );
+  for (tHashMatrix::iterator iter = similarity_map.begin(); iter != similarity_map.end(); iter++)
+  {
+    if (iter->second < tau_2)
+    {
+      continue;
+    }
+    int j = iter->first % num_features;
+    int i = (iter->first - j) / num_features;
+
+    startIndicies.clear();
+    startIndicies.insert(i);
+    DP.clear();
+    DP(i,j) = iter->second;
+
+    float maxValue = 0;
+    for (int jDP = j; jDP > j-segment_length+1; jDP--)
+    {
+      if (jDP < 1)
+      {
+        break;
+      }
+      set<int> startIndiciesCopy = startIndicies;
+      for (set<int>::iterator iterIdx = startIndiciesCopy.begin(); iterIdx != startIndiciesCopy.end(); iterIdx++)
+      {
+        long idx = *iterIdx;
+        for (int s = 0; s <= 3; ++s)
+        {
+          if (idx-s < 0)
+          {
+            break;
+          }
+          startIndicies.insert(idx-s);
+          float dp_source = DP.at( idx, jDP );
+          float dp_dest = DP.at( idx-s, jDP-1 );
+          float arr_dest = similarity_map.at( idx-s, jDP-1 );
+          DP(idx-s, jDP-1) = max( dp_dest, dp_source + arr_dest );
+          maxValue = max( DP(idx-s, jDP-1), maxValue );
+        }
+      }
+    }
+
+    if (maxValue > tau_3 * segment_length)
+    {
+      result.add( i, j, maxValue );
+    }
+  }
+  result.freeze();
+}
+
+/*
+ * Runtime of cPlaceRecognizer::postProcessSimilarities() compared to the former
+ * sparse dynamic programming (which has to yield the same segment scores) for
+ * the similarity matrices of [sizes] feature vectors, and of the sweep engine
+ * with the largest difference of its scores and the number of scores above the
+ * threshold of one engine only.
+ */
+static int benchmarkDynamicProgramming( const vector<int> & sizes )
+{
+  static const int dim_feature = DIRD::cDird::iDim_ * 16;
+  static const int safety_margin = 200;
+  static const int segment_length = 20;
+
+  cout << "N\thypotheses\tsparse [s]\tbanded [s]\tsweep [s]\tlargest difference\tdiffering scores\n";
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_features = sizes[s];
+    uint8_t * feature_vectors = createFeatures( num_features, dim_feature );
+
+    DIRD::cPlaceRecognizer place_recognizer( feature_vectors, num_features, dim_feature );
+    place_recognizer.computePairwiseSimilarity( safety_margin );
+
+    DIRD::cPlaceRecognizer::tSparseMatrix reference( num_features );
+    double time_start = getTime();
+    postProcessSimilaritiesSparse( place_recognizer, segment_length, reference );
+    double time_sparse = getTime() - time_start;
+
+    time_start = getTime();
+    place_recognizer.postProcessSimilarities( segment_length );
+    double time_banded = getTime() - time_start;
+
+    if (!isEqual( reference, place_recognizer.matDynamicProgramming_ ))
+    {
+      cerr << "Segment scores differ from the sparse dynamic programming!\n";
+      return 1;
+    }
+
+    place_recognizer.segmentEngine_ = DIRD::cPlaceRecognizer::SEGMENT_SWEEP;
+    time_start = getTime();
+    place_recognizer.postProcessSimilarities( segment_length );
+    double time_sweep = getTime() - time_start;
+
+    float max_difference = 0;
+    const DIRD::cPlaceRecognizer::tSparseMatrix & sweep = place_recognizer.matDynamicProgramming_;
+    int num_differing = (int)sweep.size();
+    for (int i = 0; i < num_features; ++i)
+    {
+      for (const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry = reference.rowBegin(i); entry != reference.rowEnd(i); ++entry)
+      {
+        const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry_sweep = sweep.lowerBound( i, entry->j );
+        if (entry_sweep == sweep.rowEnd(i) || entry_sweep->j != entry->j)
+        {
+          num_differing++;
+          continue;
+        }
+        num_differing--;
+        max_difference = max( max_difference, (float)fabs( entry_sweep->value - entry->value ) );
+      }
+    }
+
+    cout << num_features << "\t" << place_recognizer.matSimilarity_.size() << "\t" << time_sparse 
+      << "\t" << time_banded << "\t" << time_sweep << "\t" << max_difference << "\t" << num_differing << "\n";
+
+    _mm_free( feature_vectors );
+  }
+
+  return 0;
+}
+
+// the non-maxima suppression used before the anti-diagonal one of 
+// cPlaceRecognizer::computeLoops() (suppresses in place, so its result depends 
+// on the iteration order of the hash map)
+static void computeLoopsInPlace( DIRD::cPlaceRecognizer & place_recognizer, int non_max, tHashMatrix & result )
+{
+  int num_features = place_recognizer.num_features_;
+  const DIRD::cPlaceRecognizer::tSparseMatrix & scores = place_recognizer.matDynamicProgramming_;
+  for (int i = 0; i < num_features; ++i)
+  {
+    for (const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry = scores.rowBegin(i); entry != scores.rowEnd(i); ++entry)
+    {
+      result( i, entry->j ) = entry->value;
+    }
+  }
+
+  for (tHashMatrix::iterator iter = result.begin(); iter != result.end(); iter++)
+  {
+    int j = iter->first % num_features;
+    int i = (iter->first - j) / num_features;
+
+    vector<float> vecVals;
+    for (int k = -non_max+1; k < non_max; ++k)
+    {
+      vecVals.push_back( result.at(i-k, j+k) );
+    }
+
+    sort(vecVals.begin(), vecVals.end());
+    if (vecVals.size() >= 2)
+    {
+      float tau = vecVals[ vecVals.size() - 2 ];
+      for (int k = -non_max+1; k < non_max; ++k)
+      {
+        if ( result.at(i-k, j+k) != 0 && result.at(i-k, j+k) < tau )
+        {
+          result(i-k,j+k) = 0;
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Runtime of cPlaceRecognizer::computeLoops() compared to the former in place 
+ * non-maxima suppression, for the segment scores of [sizes] feature vectors. 
+ * The loops are checked against a brute force evaluation of the windows 
+ * centred on every entry (on the unsuppressed values); the former suppression
+ * is order dependent, the number of loops it finds or misses in addition is listed.
+ */
+static int benchmarkNonMaxima( const vector<int> & sizes )
+{
+  static const int dim_feature = DIRD::cDird::iDim_ * 16;
+  static const int safety_margin = 200;
+  static const int segment_length = 20;
+  static const int non_max = 60;
+
+  cout << "N\tscores\tin place [s]\tanti-diagonal [s]\tloops\tdiffering loops (in place)\n";
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_features = sizes[s];
+    uint8_t * feature_vectors = createFeatures( num_features, dim_feature );
+
+    DIRD::cPlaceRecognizer place_recognizer( feature_vectors, num_features, dim_feature );
+    place_recognizer.computePairwiseSimilarity( safety_margin );
+    place_recognizer.postProcessSimilarities( segment_length );
+    const DIRD::cPlaceRecognizer::tSparseMatrix & scores = place_recognizer.matDynamicProgramming_;
+
+    tHashMatrix in_place( num_features );
+    double time_start = getTime();
+    computeLoopsInPlace( place_recognizer, non_max, in_place );
+    double time_in_place = getTime() - time_start;
+
+    time_start = getTime();
+    place_recognizer.computeLoops( non_max );
+    double time_anti_diagonal = getTime() - time_start;
+
+    // the threshold of every window: the second largest value
+    DIRD::cPlaceRecognizer::tSparseMatrix thresholds( num_features );
+    vector<float> vecVals( 2 * non_max - 1 );
+    for (int i = 0; i < num_features; ++i)
+    {
+      for (const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry = scores.rowBegin(i); entry != scores.rowEnd(i); ++entry)
+      {
+        int j = entry->j;
+        for (int k = -non_max+1; k < non_max; ++k)
+        {
+          vecVals[ k + non_max - 1 ] = scores.at(i-k, j+k);
+        }
+        nth_element( vecVals.begin(), vecVals.end() - 2, vecVals.end() );
+        thresholds.add( i, j, vecVals[ vecVals.size() - 2 ] );
+      }
+    }
+    thresholds.freeze();
+
+    // an entry is suppressed by the thresholds of all windows it lies in
+    int num_differing = 0;
+    for (int i = 0; i < num_features; ++i)
+    {
+      for (const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry = scores.rowBegin(i); entry != scores.rowEnd(i); ++entry)
+      {
+        int j = entry->j;
+        float expected = entry->value;
+        for (int k = -non_max+1; k < non_max; ++k)
+        {
+          if (entry->value < thresholds.at(i-k, j+k))
+          {
+            expected = 0;
+          }
+        }
+
+        if (place_recognizer.matLoopClosures_.at(i,j) != expected)
+        {
+          cerr << "Loop (" << i << "," << j << ") differs from the brute force non-maxima suppression!\n";
+          return 1;
+        }
+        if (in_place.at(i,j) != expected)
+        {
+          num_differing++;
+        }
+      }
+    }
+
+    cout << num_features << "\t" << scores.size() << "\t" << time_in_place << "\t" << time_anti_diagonal 
+      << "\t" << countLoops( place_recognizer.matLoopClosures_ ) << "\t" << num_differing << "\n";
+
+    _mm_free( feature_vectors );
+  }
+
+  return 0;
+}
+
+/*
+ * Memory and access times of cPlaceRecognizer::tSparseMatrix compared to the 
+ * former hash map, for the similarity matrix of [sizes] feature vectors: 
+ * building it, reading all entries (row by row resp. in the order of the hash
+ * map) and reading the cells of random rows near the diagonal by at(). The
+ * memory of the hash map is estimated (nodes and buckets, without the overhead
+ * of the allocator).
+ */
+static int benchmarkMatrix( const vector<int> & sizes )
+{
+  static const int dim_feature = DIRD::cDird::iDim_ * 16;
+  static const int safety_margin = 200;
+  static const int num_lookups = 1000000;
+
+  cout << "N\tentries\tmatrix\tbytes/entry\tbuild [s]\titerate [s]\tat [s]\n";
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_features = sizes[s];
+    uint8_t * feature_vectors = createFeatures( num_features, dim_feature );
+
+    DIRD::cPlaceRecognizer place_recognizer( feature_vectors, num_features, dim_feature );
+    place_recognizer.computePairwiseSimilarity( safety_margin );
+    const DIRD::cPlaceRecognizer::tSparseMatrix & similarities = place_recognizer.matSimilarity_;
+    size_t num_entries = similarities.size();
+
+    vector<DIRD::cPlaceRecognizer::tSparseMatrix::tTriplet> triplets;
+    for (int i = 0; i < num_features; ++i)
+    {
+      for (const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry = similarities.rowBegin(i); entry != similarities.rowEnd(i); ++entry)
+      {
+        DIRD::cPlaceRecognizer::tSparseMatrix::tTriplet triplet = { i, entry->j, entry->value };
+        triplets.push_back( triplet );
+      }
+    }
+
+    // the same random cells for both matrices
+    vector<int> rows( num_lookups ), columns( num_lookups );
+    srand( 7 );
+    for (int l = 0; l < num_lookups; ++l)
+    {
+      rows[l] = rand() % num_features;
+      columns[l] = max( 0, rows[l] - safety_margin - rand() % (num_features / 2 + 1) );
+    }
+
+    // compressed rows
+    double time_start = getTime();
+    DIRD::cPlaceRecognizer::tSparseMatrix matrix( num_features );
+    for (size_t t = 0; t < triplets.size(); ++t)
+    {
+      matrix.add( triplets[t].i, triplets[t].j, triplets[t].value );
+    }
+    matrix.freeze();
+    double time_build = getTime() - time_start;
+
+    time_start = getTime();
+    double sum = 0;
+    for (int i = 0; i < num_features; ++i)
+    {
+      for (const DIRD::cPlaceRecognizer::tSparseMatrix::tEntry * entry = matrix.rowBegin(i); entry != matrix.rowEnd(i); ++entry)
+      {
+        sum += entry->value;
+      }
+    }
+    double time_iterate = getTime() - time_start;
+
+    time_start = getTime();
+    for (int l = 0; l < num_lookups; ++l)
+    {
+      sum += matrix.at( rows[l], columns[l] );
+    }
+    double time_at = getTime() - time_start;
+
+    size_t bytes = matrix.vecEntries_.capacity() * sizeof(DIRD::cPlaceRecognizer::tSparseMatrix::tEntry) 
+      + matrix.vecRowOffsets_.capacity() * sizeof(int);
+    cout << num_features << "\t" << num_entries << "\tcompressed rows\t" << (double)bytes / max( num_entries, (size_t)1 )
+      << "\t" << time_build << "\t" << time_iterate << "\t" << time_at << "\n";
+
+    // hash map
+    time_start = getTime();
+    tHashMatrix hash_matrix( num_features );
+    for (size_t t = 0; t < triplets.size(); ++t)
+    {
+      hash_matrix( triplets[t].i, triplets[t].j ) = triplets[t].value;
+    }
+    time_build = getTime() - time_start;
+
+    time_start = getTime();
+    double hash_sum = 0;
+    for (tHashMatrix::iterator iter = hash_matrix.begin(); iter != hash_matrix.end(); iter++)
+    {
+      hash_sum += iter->second;
+    }
+    time_iterate = getTime() - time_start;
+
+    time_start = getTime();
+    for (int l = 0; l < num_lookups; ++l)
+    {
+      hash_sum += hash_matrix.at( rows[l], columns[l] );
+    }
+    time_at = getTime() - time_start;
+
+    bytes = hash_matrix.bucket_count() * sizeof(void*) 
+      + hash_matrix.size() * (sizeof(void*) + sizeof(tHashMatrix::value_type));
+    cout << num_features << "\t" << num_entries << "\thash map\t" << (double)bytes / max( num_entries, (size_t)1 )
+      << "\t" << time_build << "\t" << time_iterate << "\t" << time_at << "\n";
+
+    if (!isEqual( matrix, similarities ) || fabs( sum - hash_sum ) > 1e-6 * fabs( sum ))
+    {
+      cerr << "The compressed rows and the hash map differ!\n";
+      return 1;
+    }
+
+    _mm_free( feature_vectors );
+  }
+
+  return 0;
+}
+
+/*
+ * Throughput of the generic SAD kernels and those specialised on the dimension
+ * of cDird and cDirdCompact (see cSadKernel::get()) for all instruction sets.
+ * Each size is the number of feature vectors, all pairs are compared.
+ */
+static int benchmarkSad( const vector<int> & sizes )
+{
+  static const int dims[] = { DIRD::cDird::iFrameDim_, DIRD::cDirdCompact::iFrameDim_ };
+
+  cout << "N\tdim\tinstruction set\tgeneric [pairs/s]\tspecialised [pairs/s]\n";
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_features = sizes[s];
+    for (size_t d = 0; d < sizeof(dims) / sizeof(dims[0]); ++d)
+    {
+      int dim_feature = dims[d];
+      uint8_t * feature_vectors = createFeatures( num_features, dim_feature );
+      double num_pairs = (double)num_features * num_features;
+
+      for (int is = DIRD::cSadKernel::SSE2; is <= DIRD::cSadKernel::detect(); ++is)
+      {
+        DIRD::cSadKernel::eInstructionSet instruction_set = (DIRD::cSadKernel::eInstructionSet)is;
+        DIRD::cSadKernel::tSadFunction kernels[] = 
+        { 
+          DIRD::cSadKernel::get( instruction_set ), DIRD::cSadKernel::get( instruction_set, dim_feature ) 
+        };
+
+        double seconds[2];
+        long sums[2];
+        for (int k = 0; k < 2; ++k)
+        {
+          sums[k] = 0;
+          double time_start = getTime();
+          for (int i = 0; i < num_features; ++i)
+          {
+            for (int j = 0; j < num_features; ++j)
+            {
+              sums[k] += kernels[k]( &feature_vectors[ i * dim_feature ], &feature_vectors[ j * dim_feature ], dim_feature );
+            }
+          }
+          seconds[k] = getTime() - time_start;
+        }
+        if (sums[0] != sums[1])
+        {
+          cerr << "Specialised SAD kernel " << DIRD::cSadKernel::name( instruction_set ) 
+            << " differs from the generic one!\n";
+          return 1;
+        }
+
+        cout << num_features << "\t" << dim_feature << "\t" << DIRD::cSadKernel::name( instruction_set ) << "\t" 
+          << num_pairs / seconds[0] << "\t" << num_pairs / seconds[1] << "\n";
+      }
+
+      _mm_free( feature_vectors );
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Per-frame runtime of shrinking camera images (KITTI 1241x376, EuRoC 752x480
+ * and 384x384) to the input of cDird and processing them, either by nearest
+ * neighbour sampling followed by cDird::process() or by cDownsampler writing 
+ * the integral image (NEAREST and AREA). The integral images of the former two
+ * are compared, AREA is compared to the 2x2 box mean for 384x384.
+ */
+static int benchmarkDownsample( const vector<int> & sizes )
+{
+  static const int width = DIRD::cDird::iFrameWidth_;
+  static const int height = DIRD::cDird::iFrameHeight_;
+  static const int src_sizes[][2] = { {1241, 376}, {752, 480}, {384, 384} };
+
+  cout << "N\tsource\tnearest + process [ms/frame]\tnearest fused [ms/frame]\tarea fused [ms/frame]\n";
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int num_frames = sizes[s];
+    for (size_t i = 0; i < sizeof(src_sizes) / sizeof(src_sizes[0]); ++i)
+    {
+      int src_width = src_sizes[i][0];
+      int src_height = src_sizes[i][1];
+      vector<uint8_t*> images( num_frames );
+      for (int n = 0; n < num_frames; ++n)
+      {
+        images[n] = createImage( src_width, src_height, n );
+      }
+
+      DIRD::cDird dird;
+      DIRD::cDird dird_fused;
+      DIRD::cDownsampler nearest( width, height, DIRD::cDownsampler::NEAREST );
+      DIRD::cDownsampler area( width, height, DIRD::cDownsampler::AREA );
+      vector<uint8_t> img_data( width * height );
+
+      // nearest neighbour sampling as compute_features did before cDownsampler
+      double time_start = getTime();
+      float scale_hor = ((float)src_width) / ((float)width);
+      float scale_ver = ((float)src_height) / ((float)height);
+      for (int n = 0; n < num_frames; ++n)
+      {
+        int k = 0;
+        for (int v = 0; v < height; v++) 
+        {
+          for (int u = 0; u < width; u++) 
+          {
+            int uu = (int)(((float)u) * scale_hor);
+            int vv = (int)(((float)v) * scale_ver);
+            img_data[k++] = images[n][ vv * src_width + uu ];
+          }
+        }
+        dird.process( &img_data[0] );
+      }
+      double time_nearest = getTime() - time_start;
+
+      time_start = getTime();
+      for (int n = 0; n < num_frames; ++n)
+      {
+        nearest.process( images[n], src_width, src_width, src_height, NULL, dird_fused.img_integral );
+        dird_fused.processIntegralImage();
+      }
+      double time_fused = getTime() - time_start;
+      if (memcmp( dird.img_integral, dird_fused.img_integral, sizeof(uint32_t) * width * height ) != 0)
+      {
+        cerr << "Integral image of cDownsampler differs from cDird::process()!\n";
+        return 1;
+      }
+
+      time_start = getTime();
+      for (int n = 0; n < num_frames; ++n)
+      {
+        area.process( images[n], src_width, src_width, src_height, NULL, dird_fused.img_integral );
+        dird_fused.processIntegralImage();
+      }
+      double time_area = getTime() - time_start;
+
+      if (src_width == 2 * width && src_height == 2 * height)
+      {
+        area.process( images[ num_frames - 1 ], src_width, src_width, src_height, &img_data[0] );
+        const uint8_t * src = images[ num_frames - 1 ];
+        for (int k = 0; k < width * height; ++k)
+        {
+          int u = 2 * (k % width);
+          int v = 2 * (k / width);
+          int sum = src[ v * src_width + u ] + src[ v * src_width + u + 1 ] + src[ (v+1) * src_width + u ] + src[ (v+1) * src_width + u + 1 ];
+          if (img_data[k] != (sum + 2) / 4)
+          {
+            cerr << "AREA sampling differs from the box mean!\n";
+            return 1;
+          }
+        }
+      }
+
+      cout << num_frames << "\t" << src_width << "x" << src_height << "\t" << time_nearest / num_frames * 1000.0 
+        << "\t" << time_fused / num_frames * 1000.0 << "\t" << time_area / num_frames * 1000.0 << "\n";
+
+      for (int n = 0; n < num_frames; ++n)
+      {
+        _mm_free( images[n] );
+      }
+    }
+  }
+
+  return 0;
+}
+
+int main (int argc, char** argv)
+{
+
+  if (argc<2)
+  {
+    cout << "\n\n";
+    cout << "Micro benchmarks of libDird on synthetic data.                                     \n";
+    cout << "                                                                                   \n";
+    cout << "\33[1mUsage\33[0m:\n  ./benchmark_dird <benchmark> [sizes ...]\n";
+    cout << "                                                                                   \n";
+    cout << "  \33[1m<benchmark> \33[0m                                                        \n";
+    cout << "                                                                                   \n";
+    cout << "    similarity   throughput of computePairwiseSimilarity() in pairs/s for all      \n";
+    cout << "                 similarity engines and each number of feature vectors in [sizes]  \n";
+    cout << "                 (default 1000 2000 4000 8000)                                     \n";
+    cout << "    recall       recall and runtime of SIMILARITY_ANN for several pruning factors  \n";
+    cout << "                 compared to the exact similarity matrix (default 2000 8000)       \n";
+    cout << "    online       per-frame latency of cOnlinePlaceRecognizer::addFrame()          \n";
+    cout << "                 (default 2000 8000)                                               \n";
+    cout << "    features     per-frame runtime of cDird::process(), get() and getGrid() for all \n";
+    cout << "                 geometries, instruction sets and memory layouts, with and without \n";
+    cout << "                 lazy evaluation (default 1000 frames)                             \n";
+    cout << "    parse        throughput of parsing text feature files in memory (default 2000) \n";
+    cout << "    sad          throughput of the generic and the dimension specialised SAD       \n";
+    cout << "                 kernels for all pairs of [sizes] feature vectors (default 2000)   \n";
+    cout << "    dp           runtime of postProcessSimilarities() compared to the former sparse\n";
+    cout << "                 dynamic programming (default 2000 4000)                           \n";
+    cout << "    downsample   per-frame runtime of shrinking camera images to the input of cDird \n";
+    cout << "                 with and without cDownsampler (default 200 frames)                \n";
+    cout << "    nms          runtime of computeLoops() compared to the former in place         \n";
+    cout << "                 non-maxima suppression (default 2000 8000)                        \n";
+    cout << "    matrix       memory and access times of the sparse similarity matrix compared  \n";
+    cout << "                 to the former hash map (default 2000 8000)                        \n";
+    cout << "                                                                                   \n";
+    cout << "\33[1mExample\33[0m:\n  ./benchmark_dird similarity 1000 2000 4000\n";
+    cout << "\n";
+    return 1;
+  }
+
+  string benchmark = argv[1];
+  vector<int> sizes;
+  for (int a = 2; a < argc; ++a)
+  {
+    sizes.push_back( atoi(argv[a]) );
+  }
+
+  if (benchmark == "similarity")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(1000);
+      sizes.push_back(2000);
+      sizes.push_back(4000);
+      sizes.push_back(8000);
+    }
+    return benchmarkSimilarity( sizes );
+  }
+
+  if (benchmark == "recall")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(2000);
+      sizes.push_back(8000);
+    }
+    return benchmarkRecall( sizes );
+  }
+
+  if (benchmark == "online")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(2000);
+      sizes.push_back(8000);
+    }
+    return benchmarkOnline( sizes );
+  }
+
+  if (benchmark == "features")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(1000);
+    }
+    cout << "geometry\tN\tlayout\tinstruction set\tpixels\tprocess [ms/frame]\tget [ms/frame]\tgetGrid [ms/frame]\tdiffering values\n";
+    if (benchmarkFeatures<DIRD::cDird>( sizes, "cDird" ) != 0)
+    {
+      return 1;
+    }
+    return benchmarkFeatures<DIRD::cDirdCompact>( sizes, "cDirdCompact" );
+  }
+
+  if (benchmark == "parse")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(2000);
+    }
+    return benchmarkParse( sizes );
+  }
+
+  if (benchmark == "sad")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(2000);
+    }
+    return benchmarkSad( sizes );
+  }
+
+  if (benchmark == "dp")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(2000);
+      sizes.push_back(4000);
+    }
+    return benchmarkDynamicProgramming( sizes );
+  }
+
+  if (benchmark == "downsample")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(200);
+    }
+    return benchmarkDownsample( sizes );
+  }
+
+  if (benchmark == "nms")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(2000);
+      sizes.push_back(8000);
+    }
+    return benchmarkNonMaxima( sizes );
+  }
+
+  if (benchmark == "matrix")
+  {
+    if (sizes.empty())
+    {
+      sizes.push_back(2000);
+      sizes.push_back(8000);
+    }
+    return benchmarkMatrix( sizes );
+  }
+
+  cerr << "Unknown benchmark " << benchmark << "\n";
+  return 1;
+}
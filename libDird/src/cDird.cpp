@@ -22,139 +22,674 @@ libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
 Street, Fifth Floor, Boston, MA 02110-1301, USA 
 */
 #include "cDird.h"
+#include "cDownsampler.h"
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+
+#include <emmintrin.h>
+
+// the AVX2 version of process() is compiled for its instruction set only, it
+// is picked at runtime (see cSadKernel::detect())
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#include <immintrin.h>
+#define DIRD_HAVE_AVX2 1
+#define DIRD_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1700
+#include <immintrin.h>
+#define DIRD_HAVE_AVX2 1
+#define DIRD_TARGET_AVX2
+#endif
+
+using namespace std;
 
 namespace DIRD
 {
-  cDird::cDird(int width, int height)
-    : iWidth_(width), iHeight_(height), bIsProcessed_(false)
+  // the sampling pattern of get(): the wavelet features of twelve pixels (x,y
+  // offsets) are summed per cell, nine cells around the pixel are concatenated
+  static const int numFineOffsets = 12;
+  static const int fineOffsets[ numFineOffsets ][2] = 
+  {
+    { 0, 0}, { 0,-3}, {-2,-2}, {-3,-1}, {-2, 2}, { 0, 5}, 
+    { 1,-1}, { 1, 0}, { 1, 2}, { 2, 2}, { 3,-1}, { 5,-1}
+  };
+  static const int numCoarseOffsets = 9;
+  static const int coarseOffsetsXY[ numCoarseOffsets ][2] = 
+  {
+    {-13,-13}, {-13, 0}, {-13, 13}, 
+    {  0,-13}, {  0, 0}, {  0, 13}, 
+    { 13,-13}, { 13, 0}, { 13, 13}
+  };
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  cDirdT<Levels, TilesX, TilesY, TileSize>::cDirdT(int width, int height, eLayout layout)
+    : iWidth_(width), iHeight_(height), layout_(layout), arrWaveletStack_(NULL), 
+    arrWaveletStackFixed_(NULL), arrWaveletPixels_(NULL), arrWaveletRows_(NULL), bIsProcessed_(false)
   {
 
     // alloc some memory for an integral image
-    img_integral = new long[iWidth_ * iHeight_] ;
+    img_integral = new uint32_t[iWidth_ * iHeight_] ;
 
-    // this is a stack of images which stores intermediate values
-    arrWaveletStack_ = new double*[ numLevels_ * 3 ];
-    for (int i = 0; i < numLevels_*3; ++i)
+    if (layout_ == PLANAR)
     {
-      arrWaveletStack_[i] = new double[ iWidth_ * iHeight_ ];
-      memset( arrWaveletStack_[i], 0, sizeof(double) * iWidth_ * iHeight_ );
+      // this is a stack of images which stores intermediate values
+      arrWaveletStack_ = new double*[ numLevels_ * 3 ];
+      for (int i = 0; i < numLevels_*3; ++i)
+      {
+        arrWaveletStack_[i] = new double[ iWidth_ * iHeight_ ];
+        memset( arrWaveletStack_[i], 0, sizeof(double) * iWidth_ * iHeight_ );
+      }
+    }
+    else if (layout_ == FIXED_POINT)
+    {
+      arrWaveletStackFixed_ = new int16_t*[ numLevels_ * 3 ];
+      for (int i = 0; i < numLevels_*3; ++i)
+      {
+        arrWaveletStackFixed_[i] = new int16_t[ iWidth_ * iHeight_ ];
+        memset( arrWaveletStackFixed_[i], 0, sizeof(int16_t) * iWidth_ * iHeight_ );
+      }
+    }
+    else
+    {
+      // one cache line of channels per pixel, rows are computed into arrWaveletRows_ first
+      arrWaveletPixels_ = (float*)_mm_malloc( sizeof(float) * numChannelsPadded_ * iWidth_ * iHeight_, 64 );
+      memset( arrWaveletPixels_, 0, sizeof(float) * numChannelsPadded_ * iWidth_ * iHeight_ );
+      arrWaveletRows_ = new double[ numLevels_ * 3 * iWidth_ ];
     }
 
     featureVector_ = new double[ iDim_ ];
+
+    setInstructionSet( cSadKernel::detect() );
   }
 
-  cDird::~cDird()
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  cDirdT<Levels, TilesX, TilesY, TileSize>::~cDirdT()
   {
     delete [] img_integral;
-    for (int i = 0; i < numLevels_*3; ++i)
+    if (arrWaveletStack_ != NULL)
     {
-      delete [] arrWaveletStack_[i];
+      for (int i = 0; i < numLevels_*3; ++i)
+      {
+        delete [] arrWaveletStack_[i];
+      }
+      delete [] arrWaveletStack_;
     }
-    delete [] arrWaveletStack_;
+    if (arrWaveletStackFixed_ != NULL)
+    {
+      for (int i = 0; i < numLevels_*3; ++i)
+      {
+        delete [] arrWaveletStackFixed_[i];
+      }
+      delete [] arrWaveletStackFixed_;
+    }
+    _mm_free( arrWaveletPixels_ );
+    delete [] arrWaveletRows_;
     delete [] featureVector_;
   }
 
-  bool cDird::process( uint8_t * img_data )
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  void cDirdT<Levels, TilesX, TilesY, TileSize>::setInstructionSet( cSadKernel::eInstructionSet instruction_set )
+  {
+    instructionSet_ = std::min( instruction_set, cSadKernel::detect() );
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  bool cDirdT<Levels, TilesX, TilesY, TileSize>::process( uint8_t * img_data )
   {
 
     // compute integral image
-    for (int v = 0; v <  iHeight_; ++v)
+    computeIntegralImage( img_data );
+
+    return processIntegralImage();
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  bool cDirdT<Levels, TilesX, TilesY, TileSize>::processIntegralImage()
+  {
+
+    // compute wavelet feature for every pixel position
+    int maxMargin = 1 << numLevels_;
+
+    if (maxMargin >= iHeight_ || maxMargin >= iWidth_)
     {
-      long sum = 0;
-      for (int u = 0; u <  iWidth_; ++u)
+      return false;
+    }
+
+    if (vecQueryPoints_.empty())
+    {
+      for (int y = maxMargin/2; y < iHeight_ - maxMargin/2; ++y)
       {
-        long idx = getIdx(u,v);
-        sum += img_data[idx];
-        img_integral[idx] = sum;
+        processRun( y, maxMargin/2, iWidth_ - maxMargin/2 );
       }
     }
-    for (int u = 0; u <  iWidth_; ++u)
+    else
     {
-      long sum = 0;
-      for (int v = 0; v <  iHeight_; ++v)
+      // lazy evaluation: only the pixels get() needs for the query points
+      for (size_t r = 0; r < vecFootprint_.size(); ++r)
       {
-        long idx = getIdx(u,v);
-        sum += img_integral[idx];
-        img_integral[idx] = sum;
+        processRun( vecFootprint_[r].y, vecFootprint_[r].x_begin, vecFootprint_[r].x_end );
       }
     }
 
-    // compute wavelet feature for every pixel position
-    int maxMargin = (int)pow(2.0, numLevels_);
+    bIsProcessed_ = true;
+    return true;
+  }
 
-    if (maxMargin >= iHeight_ || maxMargin >= iWidth_)
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  void cDirdT<Levels, TilesX, TilesY, TileSize>::processRun( int y, int x_begin, int x_end )
+  {
+    if (layout_ == FIXED_POINT)
     {
-      return false;
+      int16_t * rows[ numLevels_ * 3 ];
+      for (int d = 0; d < numLevels_*3; ++d)
+      {
+        rows[d] = &arrWaveletStackFixed_[d][ getIdx(0,y) ];
+      }
+
+      int x = x_begin;
+      if (instructionSet_ >= cSadKernel::SSE2)
+      {
+        x = computeWaveletsFixedSSE2( x, x_end, y, rows );
+      }
+      for (; x < x_end; ++x)
+      {
+        computeWaveletsFixed( x, y, rows );
+      }
+      return;
     }
 
-    for (int y = maxMargin/2; y < iHeight_ - maxMargin/2; ++y)
+    // destination of the row: the planes or the row buffer
+    double * rows[ numLevels_ * 3 ];
+    for (int d = 0; d < numLevels_*3; ++d)
     {
-      for (int x = maxMargin/2; x < iWidth_ - maxMargin/2; ++x)
-      {
+      rows[d] = layout_ == PLANAR ? &arrWaveletStack_[d][ getIdx(0,y) ] : &arrWaveletRows_[ d * iWidth_ ];
+    }
 
-        double squared_norm = 0.0;
-        long idx = getIdx(x,y);
+    int x = x_begin;
+    if (instructionSet_ >= cSadKernel::AVX2)
+    {
+      x = computeWaveletsAVX2( x, x_end, y, rows );
+    }
+    else if (instructionSet_ >= cSadKernel::SSE2)
+    {
+      x = computeWaveletsSSE2( x, x_end, y, rows );
+    }
+    for (; x < x_end; ++x)
+    {
+      computeWavelets( x, y, rows );
+    }
 
-        for (int i = 0; i < numLevels_; ++i)
+    // interleave the channels of the row
+    if (layout_ == INTERLEAVED)
+    {
+      for (x = x_begin; x < x_end; ++x)
+      {
+        float * pixel = &arrWaveletPixels_[ getIdx(x,y) * numChannelsPadded_ ];
+        for (int d = 0; d < numLevels_*3; ++d)
         {
-          int blockSize = (int)pow(2.0, i+1);
-
-          // first haar wavelet
-          long sum1, sum2, sum3, sum4, sum5, sum6;
-          sum1 = img_integral[ getIdx(x - blockSize/2, y - blockSize/2) ];
-          sum2 = img_integral[ getIdx(x              , y - blockSize/2) ];
-          sum3 = img_integral[ getIdx(x + blockSize/2, y - blockSize/2) ];
-          sum4 = img_integral[ getIdx(x + blockSize/2, y + blockSize/2) ];
-          sum5 = img_integral[ getIdx(x              , y + blockSize/2) ];
-          sum6 = img_integral[ getIdx(x - blockSize/2, y + blockSize/2) ];
-          arrWaveletStack_[ i*3 ][ idx ] = 2 * sum5 - 2 * sum2 - sum6 + sum1 - sum4 + sum3;
-          arrWaveletStack_[ i*3 ][ idx ] /= blockSize*blockSize;
-
-          // second haar wavelet
-          sum1 = img_integral[ getIdx(x - blockSize/2, y - blockSize/2) ];
-          sum2 = img_integral[ getIdx(x + blockSize/2, y - blockSize/2) ];
-          sum3 = img_integral[ getIdx(x + blockSize/2, y              ) ];
-          sum4 = img_integral[ getIdx(x + blockSize/2, y + blockSize/2) ];
-          sum5 = img_integral[ getIdx(x - blockSize/2, y + blockSize/2) ];
-          sum6 = img_integral[ getIdx(x - blockSize/2, y              ) ];
-          arrWaveletStack_[ i*3 + 1 ][ idx ] = 2*sum3 - sum2 - 2*sum6 + sum1 - sum4 + sum5;
-          arrWaveletStack_[ i*3 + 1 ][ idx ] /= blockSize*blockSize;
-
-          // third haar wavelet
-          double sum7, sum8, sum9;
-          sum7 = img_integral[ getIdx(x, y - blockSize/2) ];
-          sum8 = img_integral[ getIdx(x, y + blockSize/2) ];
-          sum9 = img_integral[ getIdx(x, y) ];
-          arrWaveletStack_[ i*3 + 2 ][ idx ] = 4*sum9 - 2*sum7 - 2*sum6 + sum1 + sum4 - 2*sum3 - 2*sum8 + sum2 + sum5;
-          arrWaveletStack_[ i*3 + 2 ][ idx ] /= blockSize*blockSize;
-
-          squared_norm += 
-            arrWaveletStack_[ i*3 ][ idx ] * arrWaveletStack_[ i*3 ][ idx ] +
-            arrWaveletStack_[ i*3 + 1 ][ idx ] * arrWaveletStack_[ i*3 + 1 ][ idx ] + 
-            arrWaveletStack_[ i*3 + 2 ][ idx ] * arrWaveletStack_[ i*3 + 2 ][ idx ];
-
+          pixel[d] = (float)rows[d][x];
         }
+      }
+    }
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  void cDirdT<Levels, TilesX, TilesY, TileSize>::addQueryPoint( int u, int v )
+  {
+    vecQueryPoints_.push_back( getIdx(u,v) );
 
-        // normalize to unit length
-        if (squared_norm > .001)
+    // mark the pixels read by get() for all query points (within the margin
+    // process() respects, pixels outside of it are zero anyway) ...
+    int margin = (1 << numLevels_) / 2;
+    vector<uint8_t> mask( iWidth_ * iHeight_, 0 );
+    for (size_t q = 0; q < vecQueryPoints_.size(); ++q)
+    {
+      int qu = vecQueryPoints_[q] % iWidth_;
+      int qv = vecQueryPoints_[q] / iWidth_;
+      for (int C = 0; C < numCoarseOffsets; ++C)
+      {
+        for (int o = 0; o < numFineOffsets; ++o)
         {
-          squared_norm = (long)sqrt((double)squared_norm);
-          for (int d = 0; d < numLevels_*3; ++d)
+          int x = qu + coarseOffsetsXY[C][0] + fineOffsets[o][0];
+          int y = qv + coarseOffsetsXY[C][1] + fineOffsets[o][1];
+          if (x >= margin && x < iWidth_ - margin && y >= margin && y < iHeight_ - margin)
           {
-            arrWaveletStack_[d][ idx ] /= squared_norm;
+            mask[ getIdx(x,y) ] = 1;
           }
         }
+      }
+    }
 
+    // ... and collect them as runs of consecutive pixels
+    vecFootprint_.clear();
+    for (int y = 0; y < iHeight_; ++y)
+    {
+      for (int x = 0; x < iWidth_; ++x)
+      {
+        if (!mask[ getIdx(x,y) ])
+        {
+          continue;
+        }
+        tRun run = { y, x, x };
+        while (run.x_end < iWidth_ && mask[ getIdx(run.x_end,y) ])
+        {
+          run.x_end++;
+        }
+        vecFootprint_.push_back( run );
+        x = run.x_end;
       }
     }
+  }
 
-    bIsProcessed_ = true;
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  void cDirdT<Levels, TilesX, TilesY, TileSize>::clearQueryPoints()
+  {
+    vecQueryPoints_.clear();
+    vecFootprint_.clear();
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  int cDirdT<Levels, TilesX, TilesY, TileSize>::getFootprintSize()
+  {
+    int num_pixels = 0;
+    for (size_t r = 0; r < vecFootprint_.size(); ++r)
+    {
+      num_pixels += vecFootprint_[r].x_end - vecFootprint_[r].x_begin;
+    }
+    return num_pixels;
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  void cDirdT<Levels, TilesX, TilesY, TileSize>::computeIntegralImage( const uint8_t * img_data )
+  {
+    // one pass: the prefix sum of a row plus the integral of the row above
+    for (int v = 0; v < iHeight_; ++v)
+    {
+      cDownsampler::integrateRow( &img_data[ getIdx(0,v) ], v > 0 ? &img_integral[ getIdx(0,v-1) ] : NULL, 
+        &img_integral[ getIdx(0,v) ], iWidth_, instructionSet_ );
+    }
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  void cDirdT<Levels, TilesX, TilesY, TileSize>::computeWavelets( int x, int y, double ** rows )
+  {
+    double squared_norm = 0.0;
+    double values[ numLevels_ * 3 ];
+
+    for (int i = 0; i < numLevels_; ++i)
+    {
+      int blockSize = 2 << i;
+      double scale = 1.0 / (blockSize*blockSize);   // exact, a power of two
+
+      // the box sums are computed modulo 2^32 (see img_integral) and are exact
+      uint32_t sum1, sum2, sum3, sum4, sum5, sum6, sum7, sum8, sum9;
+
+      // first haar wavelet
+      sum1 = img_integral[ getIdx(x - blockSize/2, y - blockSize/2) ];
+      sum2 = img_integral[ getIdx(x              , y - blockSize/2) ];
+      sum3 = img_integral[ getIdx(x + blockSize/2, y - blockSize/2) ];
+      sum4 = img_integral[ getIdx(x + blockSize/2, y + blockSize/2) ];
+      sum5 = img_integral[ getIdx(x              , y + blockSize/2) ];
+      sum6 = img_integral[ getIdx(x - blockSize/2, y + blockSize/2) ];
+      values[ i*3 ] = (int32_t)(2 * sum5 - 2 * sum2 - sum6 + sum1 - sum4 + sum3) * scale;
+
+      // second haar wavelet
+      sum1 = img_integral[ getIdx(x - blockSize/2, y - blockSize/2) ];
+      sum2 = img_integral[ getIdx(x + blockSize/2, y - blockSize/2) ];
+      sum3 = img_integral[ getIdx(x + blockSize/2, y              ) ];
+      sum4 = img_integral[ getIdx(x + blockSize/2, y + blockSize/2) ];
+      sum5 = img_integral[ getIdx(x - blockSize/2, y + blockSize/2) ];
+      sum6 = img_integral[ getIdx(x - blockSize/2, y              ) ];
+      values[ i*3 + 1 ] = (int32_t)(2*sum3 - sum2 - 2*sum6 + sum1 - sum4 + sum5) * scale;
+
+      // third haar wavelet
+      sum7 = img_integral[ getIdx(x, y - blockSize/2) ];
+      sum8 = img_integral[ getIdx(x, y + blockSize/2) ];
+      sum9 = img_integral[ getIdx(x, y) ];
+      values[ i*3 + 2 ] = (int32_t)(4*sum9 - 2*sum7 - 2*sum6 + sum1 + sum4 - 2*sum3 - 2*sum8 + sum2 + sum5) * scale;
+
+      squared_norm += 
+        values[ i*3 ] * values[ i*3 ] +
+        values[ i*3 + 1 ] * values[ i*3 + 1 ] + 
+        values[ i*3 + 2 ] * values[ i*3 + 2 ];
+
+    }
+
+    // normalize to unit length
+    if (squared_norm > .001)
+    {
+      squared_norm = (long)sqrt((double)squared_norm);
+      for (int d = 0; d < numLevels_*3; ++d)
+      {
+        values[d] /= squared_norm;
+      }
+    }
+
+    for (int d = 0; d < numLevels_*3; ++d)
+    {
+      rows[d][ x ] = values[d];
+    }
+  }
+
+  // The vectorised versions below compute the same double operations in the
+  // same order as computeWavelets() (no fused multiply-add), hence their
+  // results are bit-identical.
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  int cDirdT<Levels, TilesX, TilesY, TileSize>::computeWaveletsSSE2( int x_begin, int x_end, int y, double ** rows )
+  {
+    int x = x_begin;
+    for (; x + 4 <= x_end; x += 4)
+    {
+      __m128d squared_norm[2] = { _mm_setzero_pd(), _mm_setzero_pd() };
+
+      for (int i = 0; i < numLevels_; ++i)
+      {
+        int h = 1 << i;
+        const uint32_t * row_m = &img_integral[ getIdx(x, y - h) ];
+        const uint32_t * row_0 = &img_integral[ getIdx(x, y    ) ];
+        const uint32_t * row_p = &img_integral[ getIdx(x, y + h) ];
+        __m128i mm = _mm_loadu_si128( (const __m128i*)(row_m - h) );
+        __m128i m0 = _mm_loadu_si128( (const __m128i*)(row_m    ) );
+        __m128i mp = _mm_loadu_si128( (const __m128i*)(row_m + h) );
+        __m128i zm = _mm_loadu_si128( (const __m128i*)(row_0 - h) );
+        __m128i z0 = _mm_loadu_si128( (const __m128i*)(row_0    ) );
+        __m128i zp = _mm_loadu_si128( (const __m128i*)(row_0 + h) );
+        __m128i pm = _mm_loadu_si128( (const __m128i*)(row_p - h) );
+        __m128i p0 = _mm_loadu_si128( (const __m128i*)(row_p    ) );
+        __m128i pp = _mm_loadu_si128( (const __m128i*)(row_p + h) );
+
+        // the three haar wavelets (see computeWavelets())
+        __m128i box = _mm_add_epi32( _mm_sub_epi32( pm, mm ), _mm_sub_epi32( pp, mp ) );
+        __m128i response[3];
+        response[0] = _mm_sub_epi32( _mm_slli_epi32( _mm_sub_epi32( p0, m0 ), 1 ), box );
+        response[1] = _mm_sub_epi32( _mm_slli_epi32( _mm_sub_epi32( zp, zm ), 1 ), 
+          _mm_add_epi32( _mm_sub_epi32( pp, pm ), _mm_sub_epi32( mp, mm ) ) );
+        response[2] = _mm_add_epi32( _mm_sub_epi32( _mm_slli_epi32( z0, 2 ), 
+          _mm_slli_epi32( _mm_add_epi32( _mm_add_epi32( m0, p0 ), _mm_add_epi32( zm, zp ) ), 1 ) ),
+          _mm_add_epi32( _mm_add_epi32( mm, pp ), _mm_add_epi32( mp, pm ) ) );
+
+        __m128d scale = _mm_set1_pd( 1.0 / (4 * h * h) );
+        __m128d squares[2] = { _mm_setzero_pd(), _mm_setzero_pd() };
+        for (int w = 0; w < 3; ++w)
+        {
+          double * plane = &rows[ i*3 + w ][ x ];
+          __m128d lo = _mm_mul_pd( _mm_cvtepi32_pd( response[w] ), scale );
+          __m128d hi = _mm_mul_pd( _mm_cvtepi32_pd( _mm_unpackhi_epi64( response[w], response[w] ) ), scale );
+          _mm_storeu_pd( plane    , lo );
+          _mm_storeu_pd( plane + 2, hi );
+          squares[0] = w == 0 ? _mm_mul_pd( lo, lo ) : _mm_add_pd( squares[0], _mm_mul_pd( lo, lo ) );
+          squares[1] = w == 0 ? _mm_mul_pd( hi, hi ) : _mm_add_pd( squares[1], _mm_mul_pd( hi, hi ) );
+        }
+        squared_norm[0] = _mm_add_pd( squared_norm[0], squares[0] );
+        squared_norm[1] = _mm_add_pd( squared_norm[1], squares[1] );
+      }
+
+      // normalize to unit length (the norm is truncated to an integer)
+      __m128d threshold = _mm_set1_pd( .001 );
+      for (int k = 0; k < 2; ++k)
+      {
+        __m128d mask = _mm_cmpgt_pd( squared_norm[k], threshold );
+        __m128d norm = _mm_cvtepi32_pd( _mm_cvttpd_epi32( _mm_sqrt_pd( squared_norm[k] ) ) );
+        for (int d = 0; d < numLevels_*3; ++d)
+        {
+          double * plane = &rows[d][ x + 2*k ];
+          __m128d value = _mm_loadu_pd( plane );
+          value = _mm_or_pd( _mm_and_pd( mask, _mm_div_pd( value, norm ) ), _mm_andnot_pd( mask, value ) );
+          _mm_storeu_pd( plane, value );
+        }
+      }
+    }
+    return x;
+  }
+
+#if defined(DIRD_HAVE_AVX2)
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  DIRD_TARGET_AVX2
+  int cDirdT<Levels, TilesX, TilesY, TileSize>::computeWaveletsAVX2( int x_begin, int x_end, int y, double ** rows )
+  {
+    // same scheme as computeWaveletsSSE2() for eight pixels at once
+    int x = x_begin;
+    for (; x + 8 <= x_end; x += 8)
+    {
+      __m256d squared_norm[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+
+      for (int i = 0; i < numLevels_; ++i)
+      {
+        int h = 1 << i;
+        const uint32_t * row_m = &img_integral[ getIdx(x, y - h) ];
+        const uint32_t * row_0 = &img_integral[ getIdx(x, y    ) ];
+        const uint32_t * row_p = &img_integral[ getIdx(x, y + h) ];
+        __m256i mm = _mm256_loadu_si256( (const __m256i*)(row_m - h) );
+        __m256i m0 = _mm256_loadu_si256( (const __m256i*)(row_m    ) );
+        __m256i mp = _mm256_loadu_si256( (const __m256i*)(row_m + h) );
+        __m256i zm = _mm256_loadu_si256( (const __m256i*)(row_0 - h) );
+        __m256i z0 = _mm256_loadu_si256( (const __m256i*)(row_0    ) );
+        __m256i zp = _mm256_loadu_si256( (const __m256i*)(row_0 + h) );
+        __m256i pm = _mm256_loadu_si256( (const __m256i*)(row_p - h) );
+        __m256i p0 = _mm256_loadu_si256( (const __m256i*)(row_p    ) );
+        __m256i pp = _mm256_loadu_si256( (const __m256i*)(row_p + h) );
+
+        __m256i box = _mm256_add_epi32( _mm256_sub_epi32( pm, mm ), _mm256_sub_epi32( pp, mp ) );
+        __m256i response[3];
+        response[0] = _mm256_sub_epi32( _mm256_slli_epi32( _mm256_sub_epi32( p0, m0 ), 1 ), box );
+        response[1] = _mm256_sub_epi32( _mm256_slli_epi32( _mm256_sub_epi32( zp, zm ), 1 ), 
+          _mm256_add_epi32( _mm256_sub_epi32( pp, pm ), _mm256_sub_epi32( mp, mm ) ) );
+        response[2] = _mm256_add_epi32( _mm256_sub_epi32( _mm256_slli_epi32( z0, 2 ), 
+          _mm256_slli_epi32( _mm256_add_epi32( _mm256_add_epi32( m0, p0 ), _mm256_add_epi32( zm, zp ) ), 1 ) ),
+          _mm256_add_epi32( _mm256_add_epi32( mm, pp ), _mm256_add_epi32( mp, pm ) ) );
+
+        __m256d scale = _mm256_set1_pd( 1.0 / (4 * h * h) );
+        __m256d squares[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+        for (int w = 0; w < 3; ++w)
+        {
+          double * plane = &rows[ i*3 + w ][ x ];
+          __m256d lo = _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_castsi256_si128( response[w] ) ), scale );
+          __m256d hi = _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_extracti128_si256( response[w], 1 ) ), scale );
+          _mm256_storeu_pd( plane    , lo );
+          _mm256_storeu_pd( plane + 4, hi );
+          squares[0] = w == 0 ? _mm256_mul_pd( lo, lo ) : _mm256_add_pd( squares[0], _mm256_mul_pd( lo, lo ) );
+          squares[1] = w == 0 ? _mm256_mul_pd( hi, hi ) : _mm256_add_pd( squares[1], _mm256_mul_pd( hi, hi ) );
+        }
+        squared_norm[0] = _mm256_add_pd( squared_norm[0], squares[0] );
+        squared_norm[1] = _mm256_add_pd( squared_norm[1], squares[1] );
+      }
+
+      __m256d threshold = _mm256_set1_pd( .001 );
+      for (int k = 0; k < 2; ++k)
+      {
+        __m256d mask = _mm256_cmp_pd( squared_norm[k], threshold, _CMP_GT_OQ );
+        __m256d norm = _mm256_round_pd( _mm256_sqrt_pd( squared_norm[k] ), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC );
+        for (int d = 0; d < numLevels_*3; ++d)
+        {
+          double * plane = &rows[d][ x + 4*k ];
+          __m256d value = _mm256_loadu_pd( plane );
+          _mm256_storeu_pd( plane, _mm256_blendv_pd( value, _mm256_div_pd( value, norm ), mask ) );
+        }
+      }
+    }
+    return x;
+  }
+#else
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  int cDirdT<Levels, TilesX, TilesY, TileSize>::computeWaveletsAVX2( int x_begin, int x_end, int y, double ** rows )
+  {
+    return computeWaveletsSSE2( x_begin, x_end, y, rows );
+  }
+#endif
+
+  // Fixed point version of computeWavelets(). The value of level i is
+  // response / 4^(i+1), i.e. response * 2^(fixedPointBits_-2-2i) in fixed point
+  // (a shift). The squared norm is computed on the common denominator
+  // 4^numLevels_: a sum of squared integers below 2^53, which is exact in
+  // double, hence threshold and truncated norm are identical to
+  // computeWavelets(). Only the division by the norm is rounded (once by the
+  // float reciprocal, once to an integer).
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  void cDirdT<Levels, TilesX, TilesY, TileSize>::computeWaveletsFixed( int x, int y, int16_t ** rows )
+  {
+    int32_t responses[ numLevels_ * 3 ];
+    double squared_norm = 0.0;
+
+    for (int i = 0; i < numLevels_; ++i)
+    {
+      int h = 1 << i;
+      uint32_t mm = img_integral[ getIdx(x - h, y - h) ];
+      uint32_t m0 = img_integral[ getIdx(x    , y - h) ];
+      uint32_t mp = img_integral[ getIdx(x + h, y - h) ];
+      uint32_t zm = img_integral[ getIdx(x - h, y    ) ];
+      uint32_t z0 = img_integral[ getIdx(x    , y    ) ];
+      uint32_t zp = img_integral[ getIdx(x + h, y    ) ];
+      uint32_t pm = img_integral[ getIdx(x - h, y + h) ];
+      uint32_t p0 = img_integral[ getIdx(x    , y + h) ];
+      uint32_t pp = img_integral[ getIdx(x + h, y + h) ];
+
+      // the three haar wavelets (as in computeWaveletsSSE2())
+      uint32_t box = (pm - mm) + (pp - mp);
+      responses[ i*3     ] = (int32_t)(2 * (p0 - m0) - box);
+      responses[ i*3 + 1 ] = (int32_t)(2 * (zp - zm) - ((pp - pm) + (mp - mm)));
+      responses[ i*3 + 2 ] = (int32_t)(4 * z0 - 2 * ((m0 + p0) + (zm + zp)) + ((mm + pp) + (mp + pm)));
+
+      for (int w = 0; w < 3; ++w)
+      {
+        double value = (double)( responses[ i*3 + w ] * (1 << (2 * (numLevels_ - 1 - i))) );
+        squared_norm += value * value;
+      }
+    }
+
+    // normalize to unit length (threshold .001 and norm scaled by 4^numLevels_)
+    bool normalize = squared_norm > .001 * (double)(1 << (4 * numLevels_));
+    int norm = (int)sqrt( squared_norm ) >> (2 * numLevels_);
+    if (normalize && norm == 0)
+    {
+      for (int d = 0; d < numLevels_*3; ++d)
+      {
+        rows[d][ x ] = fixedPointInvalid_;
+      }
+      return;
+    }
+
+    __m128 reciprocal = _mm_set_ss( 1.0f );
+    if (normalize)
+    {
+      reciprocal = _mm_div_ss( reciprocal, _mm_cvtsi32_ss( reciprocal, norm ) );
+    }
+    for (int d = 0; d < numLevels_*3; ++d)
+    {
+      int shift = fixedPointBits_ - 2 - 2 * (d / 3);
+      int value = _mm_cvtss_si32( _mm_mul_ss( _mm_cvtsi32_ss( reciprocal, responses[d] * (1 << shift) ), reciprocal ) );
+      rows[d][ x ] = (int16_t)max( -32767, min( 32767, value ) );
+    }
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  int cDirdT<Levels, TilesX, TilesY, TileSize>::computeWaveletsFixedSSE2( int x_begin, int x_end, int y, int16_t ** rows )
+  {
+    int x = x_begin;
+    for (; x + 4 <= x_end; x += 4)
+    {
+      __m128i responses[ numLevels_ * 3 ];
+      __m128d squared_norm[2] = { _mm_setzero_pd(), _mm_setzero_pd() };
+
+      for (int i = 0; i < numLevels_; ++i)
+      {
+        int h = 1 << i;
+        const uint32_t * row_m = &img_integral[ getIdx(x, y - h) ];
+        const uint32_t * row_0 = &img_integral[ getIdx(x, y    ) ];
+        const uint32_t * row_p = &img_integral[ getIdx(x, y + h) ];
+        __m128i mm = _mm_loadu_si128( (const __m128i*)(row_m - h) );
+        __m128i m0 = _mm_loadu_si128( (const __m128i*)(row_m    ) );
+        __m128i mp = _mm_loadu_si128( (const __m128i*)(row_m + h) );
+        __m128i zm = _mm_loadu_si128( (const __m128i*)(row_0 - h) );
+        __m128i z0 = _mm_loadu_si128( (const __m128i*)(row_0    ) );
+        __m128i zp = _mm_loadu_si128( (const __m128i*)(row_0 + h) );
+        __m128i pm = _mm_loadu_si128( (const __m128i*)(row_p - h) );
+        __m128i p0 = _mm_loadu_si128( (const __m128i*)(row_p    ) );
+        __m128i pp = _mm_loadu_si128( (const __m128i*)(row_p + h) );
+
+        __m128i box = _mm_add_epi32( _mm_sub_epi32( pm, mm ), _mm_sub_epi32( pp, mp ) );
+        __m128i * response = &responses[ i*3 ];
+        response[0] = _mm_sub_epi32( _mm_slli_epi32( _mm_sub_epi32( p0, m0 ), 1 ), box );
+        response[1] = _mm_sub_epi32( _mm_slli_epi32( _mm_sub_epi32( zp, zm ), 1 ), 
+          _mm_add_epi32( _mm_sub_epi32( pp, pm ), _mm_sub_epi32( mp, mm ) ) );
+        response[2] = _mm_add_epi32( _mm_sub_epi32( _mm_slli_epi32( z0, 2 ), 
+          _mm_slli_epi32( _mm_add_epi32( _mm_add_epi32( m0, p0 ), _mm_add_epi32( zm, zp ) ), 1 ) ),
+          _mm_add_epi32( _mm_add_epi32( mm, pp ), _mm_add_epi32( mp, pm ) ) );
+
+        // the squares are exact integers, the order of the sum does not matter
+        for (int w = 0; w < 3; ++w)
+        {
+          __m128i value = _mm_slli_epi32( response[w], 2 * (numLevels_ - 1 - i) );
+          __m128d lo = _mm_cvtepi32_pd( value );
+          __m128d hi = _mm_cvtepi32_pd( _mm_unpackhi_epi64( value, value ) );
+          squared_norm[0] = _mm_add_pd( squared_norm[0], _mm_mul_pd( lo, lo ) );
+          squared_norm[1] = _mm_add_pd( squared_norm[1], _mm_mul_pd( hi, hi ) );
+        }
+      }
+
+      // threshold and truncated norm of the four pixels (see computeWaveletsFixed())
+      __m128d threshold = _mm_set1_pd( .001 * (double)(1 << (4 * numLevels_)) );
+      __m128 normalize = _mm_shuffle_ps( 
+        _mm_castpd_ps( _mm_cmpgt_pd( squared_norm[0], threshold ) ),
+        _mm_castpd_ps( _mm_cmpgt_pd( squared_norm[1], threshold ) ), _MM_SHUFFLE(2,0,2,0) );
+      __m128i norm = _mm_srai_epi32( _mm_unpacklo_epi64( 
+        _mm_cvttpd_epi32( _mm_sqrt_pd( squared_norm[0] ) ), 
+        _mm_cvttpd_epi32( _mm_sqrt_pd( squared_norm[1] ) ) ), 2 * numLevels_ );
+      __m128i invalid = _mm_and_si128( _mm_castps_si128( normalize ), _mm_cmpeq_epi32( norm, _mm_setzero_si128() ) );
+      invalid = _mm_packs_epi32( invalid, invalid );
+
+      __m128 one = _mm_set1_ps( 1.0f );
+      __m128 reciprocal = _mm_or_ps( _mm_and_ps( normalize, _mm_div_ps( one, _mm_cvtepi32_ps( norm ) ) ), 
+        _mm_andnot_ps( normalize, one ) );
+      __m128i lower_bound = _mm_set1_epi16( -32767 );
+      __m128i invalid_value = _mm_set1_epi16( fixedPointInvalid_ );
+      for (int d = 0; d < numLevels_*3; ++d)
+      {
+        int shift = fixedPointBits_ - 2 - 2 * (d / 3);
+        __m128i value = _mm_cvtps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( _mm_slli_epi32( responses[d], shift ) ), reciprocal ) );
+        value = _mm_max_epi16( _mm_packs_epi32( value, value ), lower_bound );
+        value = _mm_or_si128( _mm_and_si128( invalid, invalid_value ), _mm_andnot_si128( invalid, value ) );
+        _mm_storel_epi64( (__m128i*)&rows[d][ x ], value );
+      }
+    }
+    return x;
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  bool cDirdT<Levels, TilesX, TilesY, TileSize>::get( int u, int v, std::vector<uint8_t> & feature_vector )
+  {
+    if (!computeFeature( u, v ))
+    {
+      return false;
+    }
+
+    feature_vector.resize( iDim_ );
+    quantize( &feature_vector[0] );
+    return true;
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  bool cDirdT<Levels, TilesX, TilesY, TileSize>::getGrid( int tiles_x, int tiles_y, int tile_size, uint8_t * out )
+  {
+    // tiles ordered x outer, y inner (see compute_features and cFeatureStore)
+    for (int x = 0; x < tiles_x; ++x)
+    {
+      for (int y = 0; y < tiles_y; ++y)
+      {
+        if (!computeFeature( x * tile_size + tile_size/2, y * tile_size + tile_size/2 ))
+        {
+          return false;
+        }
+        quantize( &out[ (x * tiles_y + y) * iDim_ ] );
+      }
+    }
     return true;
   }
 
-  bool cDird::get( int u, int v, std::vector<uint8_t> & feature_vector )
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  bool cDirdT<Levels, TilesX, TilesY, TileSize>::computeFeature( int u, int v )
   {
 
     // check if pre-processing was done
@@ -164,7 +699,7 @@ namespace DIRD
     }
 
     // features cannot be computed closer to the image border than 20 pixels
-    if ( u<20 || v<20 || u>=iWidth_-20 || v>=iWidth_-20)
+    if ( u<20 || v<20 || u>=iWidth_-20 || v>=iHeight_-20)
     {
       return false;
     }
@@ -172,80 +707,155 @@ namespace DIRD
     // this is the pixel position that needs to be described
     long idx = getIdx(u, v);
 
+    // in lazy mode only the query points were processed
+    if (!vecQueryPoints_.empty() && find( vecQueryPoints_.begin(), vecQueryPoints_.end(), idx ) == vecQueryPoints_.end())
+    {
+      return false;
+    }
+
     // we sum several of the wavelet features (see process() and arrWaveletStack_)
     // around (u,v). We also sum the absolut values.
-    int offset0  = idx;
-    int offset1  = idx - 3 * iWidth_ + 0; 
-    int offset2  = idx - 2 * iWidth_ - 2; 
-    int offset3  = idx - 1 * iWidth_ - 3; 
-    int offset4  = idx + 2 * iWidth_ - 2; 
-    int offset5  = idx + 5 * iWidth_ + 0; 
-    int offset6  = idx - 1 * iWidth_ + 1; 
-    int offset7  = idx + 1; 
-    int offset8  = idx + 2 * iWidth_ + 1; 
-    int offset9  = idx + 2 * iWidth_ + 2; 
-    int offset10 = idx - 1 * iWidth_ + 3; 
-    int offset11 = idx - 1 * iWidth_ + 5; 
+    int offsets[ numFineOffsets ];
+    for (int o = 0; o < numFineOffsets; ++o)
+    {
+      offsets[o] = idx + fineOffsets[o][1] * iWidth_ + fineOffsets[o][0];
+    }
 
     // finally we concatinate nine such feature vectors to form the final DIRD
-    static const int Off = 13;
-    int coarseOffsets[] = 
-    {
-      -Off * iWidth_ - Off,
-      0 * iWidth_ - Off,
-      Off * iWidth_ - Off,
-      -Off * iWidth_,
-      0 * iWidth_,
-      Off * iWidth_,
-      -Off * iWidth_ + Off,
-      0 * iWidth_ + Off,
-      Off * iWidth_ + Off,
-    }; 
+    int coarseOffsets[ numCoarseOffsets ];
+    for (int C = 0; C < numCoarseOffsets; ++C)
+    {
+      coarseOffsets[C] = coarseOffsetsXY[C][1] * iWidth_ + coarseOffsetsXY[C][0];
+    }
 
     // clear the feature vector
     memset( featureVector_, 0, sizeof(double) * iDim_ );
 
     // loop over these nine feature vectors which shall be concatinated
-    for (int C = 0; C < sizeof(coarseOffsets)/sizeof(coarseOffsets[0]); C++)
+    for (int C = 0; C < numCoarseOffsets && layout_ == INTERLEAVED; C++)
+    {
+      // all channels of a pixel at once (the same summation in float)
+      static const int numVectors = (numLevels_ * 3 + 3) / 4;
+      __m128 sign = _mm_set1_ps( -0.0f );
+      __m128 sum[ numVectors ];
+      __m128 sum_abs[ numVectors ];
+      for (int k = 0; k < numVectors; ++k)
+      {
+        sum[k] = _mm_setzero_ps();
+        sum_abs[k] = _mm_setzero_ps();
+      }
+      for (int o = 0; o < numFineOffsets; ++o)
+      {
+        const float * pixel = &arrWaveletPixels_[ (offsets[o] + coarseOffsets[C]) * numChannelsPadded_ ];
+        for (int k = 0; k < numVectors; ++k)
+        {
+          __m128 value = _mm_load_ps( pixel + 4*k );
+          sum[k] = _mm_add_ps( sum[k], value );
+          sum_abs[k] = _mm_add_ps( sum_abs[k], _mm_andnot_ps( sign, value ) );
+        }
+      }
+
+      float channels[ 2 * 4 * numVectors ];
+      for (int k = 0; k < numVectors; ++k)
+      {
+        _mm_storeu_ps( &channels[ 4*k ], sum[k] );
+        _mm_storeu_ps( &channels[ 4*numVectors + 4*k ], sum_abs[k] );
+      }
+      for (int i = 0; i < numLevels_*3; ++i)
+      {
+        featureVector_[ 2 * (i + C * numLevels_*3) ] = channels[i];
+        featureVector_[ 2 * (i + C * numLevels_*3) + 1 ] = channels[ 4*numVectors + i ];
+      }
+    }
+
+    for (int C = 0; C < numCoarseOffsets && layout_ == FIXED_POINT; C++)
+    {
+      // integer sums, converted exactly to double
+      for (int i = 0; i < numLevels_*3; ++i)
+      {
+        const int16_t * plane = &arrWaveletStackFixed_[i][ coarseOffsets[C] ];
+        int sum = 0;
+        int sum_abs = 0;
+        bool valid = true;
+        for (int o = 0; o < numFineOffsets; ++o)
+        {
+          int value = plane[ offsets[o] ];
+          valid = valid && value != fixedPointInvalid_;
+          sum += value;
+          sum_abs += abs( value );
+        }
+
+        // a pixel without valid norm makes both values 0 (see fixedPointInvalid_)
+        const double scale = 1.0 / (1 << fixedPointBits_);
+        featureVector_[ 2 * (i + C * numLevels_*3) ] = valid ? sum * scale : -100.0;
+        featureVector_[ 2 * (i + C * numLevels_*3) + 1 ] = valid ? sum_abs * scale : -100.0;
+      }
+    }
+
+    for (int C = 0; C < numCoarseOffsets && layout_ == PLANAR; C++)
     {
       // compute the summation
-      for (size_t i = 0; i < numLevels_*3; ++i)
+      for (int i = 0; i < numLevels_*3; ++i)
       {
         featureVector_[ 2 * (i + C * numLevels_*3) ] = 
-          arrWaveletStack_[i][ offset0  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset1  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset2  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset3  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset4  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset5  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset6  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset7  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset8  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset9  + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset10 + coarseOffsets[C] ] +
-          arrWaveletStack_[i][ offset11 + coarseOffsets[C] ] 
+          arrWaveletStack_[i][ offsets[0] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[1] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[2] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[3] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[4] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[5] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[6] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[7] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[8] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[9] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[10] + coarseOffsets[C] ] +
+          arrWaveletStack_[i][ offsets[11] + coarseOffsets[C] ] 
           ;
 
         featureVector_[ 2 * (i + C * numLevels_*3) + 1 ] = 
-          fabs(arrWaveletStack_[i][ offset0  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset1  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset2  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset3  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset4  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset5  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset6  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset7  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset8  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset9  + coarseOffsets[C] ] )+
-          fabs(arrWaveletStack_[i][ offset10 + coarseOffsets[C] ]) +
-          fabs(arrWaveletStack_[i][ offset11 + coarseOffsets[C] ]) 
+          fabs(arrWaveletStack_[i][ offsets[0] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[1] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[2] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[3] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[4] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[5] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[6] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[7] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[8] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[9] + coarseOffsets[C] ] )+
+          fabs(arrWaveletStack_[i][ offsets[10] + coarseOffsets[C] ]) +
+          fabs(arrWaveletStack_[i][ offsets[11] + coarseOffsets[C] ]) 
           ;
       }
     }
 
-    // finally we squeeze the "contiuous" feature into uint8_t by scaling (and adding offsets)
-    feature_vector.clear();
-    for (int d = 0; d <  iDim_; ++d)
+    return true;
+  }
+
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  void cDirdT<Levels, TilesX, TilesY, TileSize>::quantize( uint8_t * feature )
+  {
+    // finally we squeeze the "contiuous" feature into uint8_t by scaling (and adding offsets):
+    // (int)(10 * value + 100) clamped to 0 ... 255, done by truncating conversions and
+    // saturating packs for eight values at a time
+    __m128d scale = _mm_set1_pd( 10.0 );
+    __m128d offset = _mm_set1_pd( 100.0 );
+    int d = 0;
+    for (; d + 8 <= iDim_; d += 8)
+    {
+      __m128i values[4];
+      for (int k = 0; k < 4; ++k)
+      {
+        __m128d value = _mm_add_pd( _mm_mul_pd( _mm_loadu_pd( &featureVector_[ d + 2*k ] ), scale ), offset );
+        values[k] = _mm_cvttpd_epi32( value );
+      }
+      __m128i lo = _mm_unpacklo_epi64( values[0], values[1] );
+      __m128i hi = _mm_unpacklo_epi64( values[2], values[3] );
+      __m128i packed = _mm_packus_epi16( _mm_packs_epi32( lo, hi ), _mm_setzero_si128() );
+      _mm_storel_epi64( (__m128i*)&feature[d], packed );
+    }
+
+    for (; d <  iDim_; ++d)
     {
       int val = (int) ( 10 * featureVector_[d] + 100 );
       if (val < 0)
@@ -257,9 +867,11 @@ namespace DIRD
         val = 255;
       }
 
-      feature_vector.push_back( (uint8_t) val );
+      feature[d] = (uint8_t) val;
     }
-
-    return true;
   }
+
+  // the geometries used by libDird
+  template class cDirdT<4, 4, 4, 48>;
+  template class cDirdT<3, 2, 2, 48>;
 }
@@ -24,18 +24,23 @@ Street, Fifth Floor, Boston, MA 02110-1301, USA
 
 #pragma once
 
-#if _MSC_VER <= 1500
+#if defined(_MSC_VER) && _MSC_VER <= 1500
 typedef unsigned char uint8_t;
+typedef unsigned int uint32_t;
+typedef int int32_t;
+typedef short int16_t;
 #else
 #include <stdint.h>
 #endif
 
 #include <vector>
 
+#include "cSadKernel.h"
+
 namespace DIRD
 {
 
-  /*@class cDird
+  /*@class cDirdT
    *
    * This class can extract DIRD features from an image.
    * Dird is an Illumination Robust Descriptor 
@@ -45,23 +50,77 @@ namespace DIRD
    * Thereafter a feature vector can be computed for any pixel position
    * of the image (see get()).
    *
+   * process() is vectorised (SSE2 or AVX2, picked at runtime like the SAD
+   * kernels of cPlaceRecognizer). All instruction sets yield bit-identical
+   * wavelet planes.
+   *
+   * The wavelet features are stored either as one image per channel (PLANAR,
+   * default) or with all channels of a pixel next to each other in one cache
+   * line (INTERLEAVED, in float). The latter speeds up get() which reads all
+   * channels of few pixels, but descriptors may differ in rare cases due to
+   * the single precision sums.
+   *
+   * If only few descriptors per image are needed, their pixel positions can
+   * be registered beforehand (see addQueryPoint()). process() then computes
+   * the wavelet features of the pixels get() reads for these positions only
+   * (lazy evaluation), the descriptors are identical.
+   *
+   * The FIXED_POINT layout stores the wavelet features as planes of int16
+   * (a quarter of the memory of PLANAR). process() then runs in integer
+   * arithmetic: the haar responses are scaled by shifts instead of divisions,
+   * the norm is computed exactly, and only the final division by the norm
+   * uses one float reciprocal per pixel. The values are rounded to
+   * fixedPointBits_ fractional bits, so a quantised value differs from
+   * PLANAR only if the double sum lies within a few 1e-4 of a step of the
+   * quantisation.
+   *
+   * The geometry of the descriptor is fixed at compile time: the number of
+   * decomposition levels of the wavelet features and the grid of tiles whose
+   * centres describe an image (see getGrid()). cDird is the geometry used
+   * throughout libDird, cDirdCompact a smaller one (e.g. for embedded
+   * systems). Both are instantiated in cDird.cpp.
+   *
    */
-  class cDird
+  template <int Levels, int TilesX, int TilesY, int TileSize>
+  class cDirdT
   {
 
     public: /* public classes/enums/types etc... */
 
+      /**
+       * @brief memory layout of the wavelet features (see arrWaveletStack_ and arrWaveletPixels_)
+       */
+      enum eLayout
+      {
+        PLANAR,
+        INTERLEAVED,
+        FIXED_POINT
+      };
+
+      /**
+       * @brief a run of consecutive pixels x_begin ... x_end-1 of row y
+       */
+      struct tRun
+      {
+        int y;
+        int x_begin;
+        int x_end;
+      };
+
     public: /* public methods */
 
       /**
        * construct a cDird object from scratch
+       * @param width width of the images (iFrameWidth_ for getGrid())
+       * @param height height of the images (iFrameHeight_ for getGrid())
+       * @param layout memory layout of the wavelet features
        */
-      cDird(int width, int height);
+      cDirdT(int width = iFrameWidth_, int height = iFrameHeight_, eLayout layout = PLANAR);
 
       /**
        * destruct a cDird object
        */
-      ~cDird();
+      ~cDirdT();
 
       /**
        * @brief pre-processes the entire image for quick feature computation thereafter (see get()-method)
@@ -70,6 +129,91 @@ namespace DIRD
        */
       bool process( uint8_t * img_data );
 
+      /**
+       * @brief same as process() for an image whose integral image was written to 
+       * img_integral beforehand (e.g. by cDownsampler::process())
+       * @return true if processing went ok, false otherwise 
+       */
+      bool processIntegralImage();
+
+      /**
+       * @brief selects the instruction set of process(). By default the fastest one
+       * supported by the CPU is used (see cSadKernel::detect())
+       * @param instruction_set requested instruction set (falls back to a supported one)
+       */
+      void setInstructionSet( cSadKernel::eInstructionSet instruction_set );
+
+      /**
+       * @brief registers a pixel position get() will be called for. Once a position is
+       * registered, process() evaluates only the wavelet features needed for the
+       * registered positions and get() fails for all other positions.
+       * @param u column index
+       * @param v row index
+       */
+      void addQueryPoint( int u, int v );
+
+      /**
+       * @brief removes all registered positions, process() handles the entire image again
+       */
+      void clearQueryPoints();
+
+      /**
+       * @brief number of pixels whose wavelet features process() computes in lazy mode
+       */
+      int getFootprintSize();
+
+      /**
+       * @brief computes the wavelet features of the pixels x_begin ... x_end-1 of row y
+       * and stores them in the layout in use
+       */
+      void processRun( int y, int x_begin, int x_end );
+
+      /**
+       * @brief computes the integral image of the input image (img_integral)
+       * @param img_data the input image
+       */
+      void computeIntegralImage( const uint8_t * img_data );
+
+      /**
+       * @brief computes the normalized wavelet features of one pixel from the integral image
+       * @param x column index
+       * @param y row index
+       * @param rows destination, row y of each channel
+       */
+      void computeWavelets( int x, int y, double ** rows );
+
+      /**
+       * @brief computes the normalized wavelet features of the pixels x_begin ... x_end-1
+       * of a row, several pixels at once (remaining pixels are left to computeWavelets())
+       * @return first pixel which was not processed
+       * @param x_begin first column
+       * @param x_end end of the columns
+       * @param y row index
+       * @param rows destination, row y of each channel
+       */
+      int computeWaveletsSSE2( int x_begin, int x_end, int y, double ** rows );
+      int computeWaveletsAVX2( int x_begin, int x_end, int y, double ** rows );
+
+      /**
+       * @brief computes the wavelet features of one pixel in fixed point (FIXED_POINT layout),
+       * i.e. the values of computeWavelets() rounded to fixedPointBits_ fractional bits
+       * @param x column index
+       * @param y row index
+       * @param rows destination, row y of each channel
+       */
+      void computeWaveletsFixed( int x, int y, int16_t ** rows );
+
+      /**
+       * @brief computes the wavelet features of a row in fixed point, four pixels at once
+       * (bit-identical to computeWaveletsFixed())
+       * @return first pixel which was not processed
+       * @param x_begin first column
+       * @param x_end end of the columns
+       * @param y row index
+       * @param rows destination, row y of each channel
+       */
+      int computeWaveletsFixedSSE2( int x_begin, int x_end, int y, int16_t ** rows );
+
       /**
        * @brief computes a DIRD feature vector for specified pixel position. Can only be called after process(). 
        * @return true if processing went ok, false otherwise 
@@ -79,6 +223,44 @@ namespace DIRD
        */
       bool get( int u, int v, std::vector<uint8_t> & feature_vector );
 
+      /**
+       * @brief computes the DIRD feature vectors of the centres of a grid of tiles, i.e. the
+       * feature vector of a whole image, without allocating memory. Can only be called after process().
+       * @return true if processing went ok, false otherwise 
+       * @param tiles_x number of tiles horizontally
+       * @param tiles_y number of tiles vertically
+       * @param tile_size number of pixels of one tile (horizontally and vertically)
+       * @param out destination of tiles_x * tiles_y * iDim_ values, ordered tile by tile
+       * with x outer and y inner (e.g. a record of a cFeatureStore, ideally 64 byte aligned)
+       */
+      bool getGrid( int tiles_x, int tiles_y, int tile_size, uint8_t * out );
+
+      /**
+       * @brief computes the feature vector of a whole image for the tiling of the geometry
+       * (numTilesX_ x numTilesY_ tiles of tileSize_ pixels)
+       * @return true if processing went ok, false otherwise 
+       * @param out destination of iFrameDim_ values (see above)
+       */
+      inline bool getGrid( uint8_t * out )
+      {
+        return getGrid( numTilesX_, numTilesY_, tileSize_, out );
+      }
+
+      /**
+       * @brief computes the feature vector for a pixel position before it is squeezed into
+       * uint8_t (featureVector_)
+       * @return true if processing went ok, false otherwise 
+       * @param u column index
+       * @param v row index
+       */
+      bool computeFeature( int u, int v );
+
+      /**
+       * @brief squeezes featureVector_ into uint8_t
+       * @param feature destination (iDim_ values)
+       */
+      void quantize( uint8_t * feature );
+
       /**
        * @brief compute linear index
        * @return linear index into image
@@ -108,7 +290,7 @@ namespace DIRD
        * IMPORTANT: if you change the values below then the parameters
        * of the logistic function in cPlaceRecognizer.cpp need to be adjusted!
        */
-      static const int numLevels_ = 4;
+      static const int numLevels_ = Levels;
 
       /**
        * @brief dimension of the feature vector
@@ -116,15 +298,92 @@ namespace DIRD
       static const int iDim_ = numLevels_ * 9 * 6;
 
       /**
-       * @brief the integral image of the input image
+       * @brief tiling of an image (see getGrid()): number of tiles horizontally and
+       * vertically and number of pixels of one tile
+       */
+      static const int numTilesX_ = TilesX;
+      static const int numTilesY_ = TilesY;
+      static const int tileSize_ = TileSize;
+
+      /**
+       * @brief size of an image that is tiled (the input image is down sampled to it)
+       */
+      static const int iFrameWidth_ = TilesX * TileSize;
+      static const int iFrameHeight_ = TilesY * TileSize;
+
+      /**
+       * @brief dimension of the feature vector of a whole image (see getGrid())
+       */
+      static const int iFrameDim_ = iDim_ * TilesX * TilesY;
+
+      /**
+       * @brief number of floats per pixel of the INTERLEAVED layout (numLevels_*3 channels
+       * padded to a multiple of 64 bytes, get() loads the channels as SSE vectors)
+       */
+      static const int numChannelsPadded_ = (numLevels_ * 3 + 15) / 16 * 16;
+
+      /**
+       * @brief number of fractional bits of the FIXED_POINT layout. Normalized values are
+       * smaller than 2 in magnitude, hence they fit into int16 (numLevels_ must not exceed 7).
+       */
+      static const int fixedPointBits_ = 14;
+
+      /**
+       * @brief value of all channels of a pixel of the FIXED_POINT layout whose norm is
+       * truncated to zero. The double version divides by zero there, which turns the
+       * descriptor values the pixel contributes to into 0 after quantisation.
        */
-      long * img_integral;
+      static const int16_t fixedPointInvalid_ = -32768;
 
       /**
-       * @brief a stack of wavelet transformed images
+       * @brief memory layout of the wavelet features
+       */
+      eLayout layout_;
+
+      /**
+       * @brief the integral image of the input image. It is kept modulo 2^32 (unsigned
+       * overflow wraps around), differences of it, i.e. sums over boxes, are exact
+       * as long as the box covers less than 2^31/255 pixels.
+       */
+      uint32_t * img_integral;
+
+      /**
+       * @brief a stack of wavelet transformed images (PLANAR layout only, NULL otherwise)
        */
       double ** arrWaveletStack_;
 
+      /**
+       * @brief a stack of wavelet transformed images in fixed point (FIXED_POINT layout only,
+       * NULL otherwise)
+       */
+      int16_t ** arrWaveletStackFixed_;
+
+      /**
+       * @brief the wavelet features of all pixels, numChannelsPadded_ per pixel and
+       * 64 byte aligned (INTERLEAVED layout only, NULL otherwise)
+       */
+      float * arrWaveletPixels_;
+
+      /**
+       * @brief the wavelet features of the row being processed (INTERLEAVED layout only)
+       */
+      double * arrWaveletRows_;
+
+      /**
+       * @brief registered pixel positions (linear indices, see addQueryPoint())
+       */
+      std::vector<long> vecQueryPoints_;
+
+      /**
+       * @brief the pixels whose wavelet features are needed for vecQueryPoints_
+       */
+      std::vector<tRun> vecFootprint_;
+
+      /**
+       * @brief instruction set used by process() (see setInstructionSet())
+       */
+      cSadKernel::eInstructionSet instructionSet_;
+
       /**
        * @brief safety flag whether image has been pre-processed or not
        */
@@ -136,4 +395,14 @@ namespace DIRD
       double * featureVector_;
 
   };
+
+  /**
+   * @brief the descriptor of libDird: 4 levels, 4x4 tiles of 48 pixels (3456 dimensions)
+   */
+  typedef cDirdT<4, 4, 4, 48> cDird;
+
+  /**
+   * @brief a compact descriptor: 3 levels, 2x2 tiles of 48 pixels (648 dimensions)
+   */
+  typedef cDirdT<3, 2, 2, 48> cDirdCompact;
 }
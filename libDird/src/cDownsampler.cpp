@@ -0,0 +1,232 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include "cDownsampler.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+
+using namespace std;
+
+namespace DIRD
+{
+
+  // the source pixels (and their weights) of every destination pixel along one axis
+  static void computeSpans( int src_size, int dst_size, cDownsampler::eMode mode, vector<cDownsampler::tSpan> & spans, vector<int> & weights )
+  {
+    spans.resize( dst_size );
+
+    // the same float arithmetic the demo programs used for nearest neighbour sampling
+    float scale = ((float)src_size) / ((float)dst_size);
+
+    for (int u = 0; u < dst_size; ++u)
+    {
+      cDownsampler::tSpan & span = spans[u];
+      span.weights = (int)weights.size();
+      if (mode == cDownsampler::NEAREST)
+      {
+        span.first = (int)(((float)u) * scale);
+        span.count = 1;
+        weights.push_back( 1 );
+        continue;
+      }
+
+      // destination pixel u covers [begin, end) in units of 1/dst_size source pixels
+      int begin = u * src_size;
+      int end = (u + 1) * src_size;
+      span.first = begin / dst_size;
+      span.count = (end - 1) / dst_size - span.first + 1;
+      for (int x = span.first; x < span.first + span.count; ++x)
+      {
+        weights.push_back( min( (x + 1) * dst_size, end ) - max( x * dst_size, begin ) );
+      }
+    }
+  }
+
+  // acc[x] += weight * row[x] (weight < 2^15)
+  static void accumulateRow( const uint8_t * row, int weight, uint32_t * acc, int width, cSadKernel::eInstructionSet instruction_set )
+  {
+    int x = 0;
+    if (instruction_set >= cSadKernel::SSE2)
+    {
+      // the pixels are widened to 32 bit lanes, whose upper 16 bits are zero, 
+      // thus madd yields pixel * weight per lane
+      __m128i zero = _mm_setzero_si128();
+      __m128i weights = _mm_set1_epi32( weight );
+      for (; x + 16 <= width; x += 16)
+      {
+        __m128i pixels = _mm_loadu_si128( (const __m128i*)&row[x] );
+        __m128i lo = _mm_unpacklo_epi8( pixels, zero );
+        __m128i hi = _mm_unpackhi_epi8( pixels, zero );
+        __m128i p[4] = 
+        { 
+          _mm_unpacklo_epi16( lo, zero ), _mm_unpackhi_epi16( lo, zero ),
+          _mm_unpacklo_epi16( hi, zero ), _mm_unpackhi_epi16( hi, zero ) 
+        };
+        for (int k = 0; k < 4; ++k)
+        {
+          __m128i * dest = (__m128i*)&acc[ x + 4*k ];
+          _mm_storeu_si128( dest, _mm_add_epi32( _mm_loadu_si128( dest ), _mm_madd_epi16( p[k], weights ) ) );
+        }
+      }
+    }
+
+    for (; x < width; ++x)
+    {
+      acc[x] += weight * row[x];
+    }
+  }
+
+  cDownsampler::cDownsampler( int width, int height, eMode mode )
+    : iWidth_(width), iHeight_(height), mode_(mode), iSrcWidth_(0), iSrcHeight_(0), 
+    vecRow_(width), instructionSet_(cSadKernel::detect())
+  {
+  }
+
+  void cDownsampler::setInstructionSet( cSadKernel::eInstructionSet instruction_set )
+  {
+    instructionSet_ = min( instruction_set, cSadKernel::detect() );
+  }
+
+  void cDownsampler::setSourceSize( int src_width, int src_height )
+  {
+    iSrcWidth_ = src_width;
+    iSrcHeight_ = src_height;
+    vecWeights_.clear();
+    computeSpans( src_width, iWidth_, mode_, vecColumns_, vecWeights_ );
+    computeSpans( src_height, iHeight_, mode_, vecRows_, vecWeights_ );
+    vecAccumulator_.resize( mode_ == AREA ? src_width : 0 );
+  }
+
+  bool cDownsampler::process( const uint8_t * src, int pitch, int src_width, int src_height, uint8_t * dst, uint32_t * integral )
+  {
+    if (src == NULL || src_width <= 0 || src_height <= 0 || iWidth_ <= 0 || iHeight_ <= 0 || (dst == NULL && integral == NULL))
+    {
+      return false;
+    }
+
+    // the weights of a row need to fit into 16 bits (see accumulateRow())
+    if (mode_ == AREA && min( iHeight_, src_height ) >= (1 << 15))
+    {
+      return false;
+    }
+
+    if (src_width != iSrcWidth_ || src_height != iSrcHeight_)
+    {
+      setSourceSize( src_width, src_height );
+    }
+
+    // the sum of the weights of a destination pixel
+    uint64_t area = (uint64_t)src_width * src_height;
+
+    for (int v = 0; v < iHeight_; ++v)
+    {
+      uint8_t * out = dst != NULL ? &dst[ v * iWidth_ ] : &vecRow_[0];
+      const tSpan & span_v = vecRows_[v];
+
+      if (mode_ == NEAREST)
+      {
+        const uint8_t * row = &src[ span_v.first * pitch ];
+        for (int u = 0; u < iWidth_; ++u)
+        {
+          out[u] = row[ vecColumns_[u].first ];
+        }
+      }
+      else
+      {
+        // weighted sum of the source rows ...
+        uint32_t * acc = &vecAccumulator_[0];
+        fill( vecAccumulator_.begin(), vecAccumulator_.end(), 0 );
+        for (int k = 0; k < span_v.count; ++k)
+        {
+          accumulateRow( &src[ (span_v.first + k) * pitch ], vecWeights_[ span_v.weights + k ], acc, src_width, instructionSet_ );
+        }
+
+        // ... and of its columns, rounded to the nearest grey value
+        for (int u = 0; u < iWidth_; ++u)
+        {
+          const tSpan & span_u = vecColumns_[u];
+          const int * weights = &vecWeights_[ span_u.weights ];
+          uint64_t sum = 0;
+          for (int k = 0; k < span_u.count; ++k)
+          {
+            sum += (uint64_t)weights[k] * acc[ span_u.first + k ];
+          }
+          out[u] = (uint8_t)((sum + area/2) / area);
+        }
+      }
+
+      if (integral != NULL)
+      {
+        integrateRow( out, v > 0 ? &integral[ (v-1) * iWidth_ ] : NULL, &integral[ v * iWidth_ ], iWidth_, instructionSet_ );
+      }
+    }
+
+    return true;
+  }
+
+  void cDownsampler::integrateRow( const uint8_t * row, const uint32_t * above, uint32_t * dest, int width, cSadKernel::eInstructionSet instruction_set )
+  {
+    uint32_t sum = 0;
+    int u = 0;
+
+    if (instruction_set >= cSadKernel::SSE2)
+    {
+      // 16 pixels at a time: four prefix sums of four 32 bit lanes each
+      __m128i zero  = _mm_setzero_si128();
+      __m128i carry = _mm_setzero_si128();
+      for (; u + 16 <= width; u += 16)
+      {
+        __m128i pixels = _mm_loadu_si128( (const __m128i*)&row[u] );
+        __m128i lo = _mm_unpacklo_epi8( pixels, zero );
+        __m128i hi = _mm_unpackhi_epi8( pixels, zero );
+        __m128i x[4] = 
+        { 
+          _mm_unpacklo_epi16( lo, zero ), _mm_unpackhi_epi16( lo, zero ),
+          _mm_unpacklo_epi16( hi, zero ), _mm_unpackhi_epi16( hi, zero ) 
+        };
+        for (int k = 0; k < 4; ++k)
+        {
+          x[k] = _mm_add_epi32( x[k], _mm_slli_si128( x[k], 4 ) );
+          x[k] = _mm_add_epi32( x[k], _mm_slli_si128( x[k], 8 ) );
+          x[k] = _mm_add_epi32( x[k], carry );
+          carry = _mm_shuffle_epi32( x[k], 0xFF );
+          __m128i result = x[k];
+          if (above != NULL)
+          {
+            result = _mm_add_epi32( result, _mm_loadu_si128( (const __m128i*)&above[ u + 4*k ] ) );
+          }
+          _mm_storeu_si128( (__m128i*)&dest[ u + 4*k ], result );
+        }
+      }
+      sum = (uint32_t)_mm_cvtsi128_si32( carry );
+    }
+
+    for (; u < width; ++u)
+    {
+      sum += row[u];
+      dest[u] = sum + (above != NULL ? above[u] : 0);
+    }
+  }
+}
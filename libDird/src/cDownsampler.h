@@ -0,0 +1,174 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+
+#pragma once
+
+#if defined(_MSC_VER) && _MSC_VER <= 1500
+typedef unsigned char uint8_t;
+typedef unsigned int uint32_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+#include <stddef.h>
+#include <vector>
+
+#include "cSadKernel.h"
+
+namespace DIRD
+{
+
+  /*@class cDownsampler
+   *
+   * Shrinks a grey value image of arbitrary size (e.g. 1241x376 or 752x480)
+   * to the input size of cDird, optionally straight into the integral image
+   * cDird::process() would compute from it (see cDird::processIntegralImage()).
+   *
+   * NEAREST picks one source pixel per destination pixel exactly like the
+   * demo programs always did. AREA averages every source pixel with the
+   * fraction of it a destination pixel covers (a box filter for integer
+   * ratios). It reads every source row once, in integer arithmetic, and is
+   * vectorised with SSE2 across the columns. As it removes aliasing the
+   * descriptors differ from those of NEAREST, features of both must not be
+   * mixed.
+   *
+   */
+  class cDownsampler
+  {
+
+    public: /* public classes/enums/types etc... */
+
+      /**
+       * @brief sampling of the source image
+       */
+      enum eMode
+      {
+        NEAREST,
+        AREA
+      };
+
+      /**
+       * @brief the source pixels first ... first+count-1 (of a row or a column) a destination
+       * pixel is computed from, with their weights starting at vecWeights_[weights]
+       */
+      struct tSpan
+      {
+        int first;
+        int count;
+        int weights;
+      };
+
+    public: /* public methods */
+
+      /**
+       * construct a cDownsampler object
+       * @param width width of the destination images
+       * @param height height of the destination images
+       * @param mode sampling of the source images
+       */
+      cDownsampler( int width, int height, eMode mode = AREA );
+
+      /**
+       * @brief shrinks (or enlarges) an image
+       * @return true if sampling went ok, false otherwise
+       * @param src first row of the source image
+       * @param pitch bytes from one source row to the next
+       * @param src_width width of the source image
+       * @param src_height height of the source image
+       * @param dst destination image of width x height pixels (may be NULL if integral is given)
+       * @param integral integral image of the destination image (may be NULL), e.g. cDird::img_integral
+       */
+      bool process( const uint8_t * src, int pitch, int src_width, int src_height, uint8_t * dst, uint32_t * integral = NULL );
+
+      /**
+       * @brief selects the instruction set. By default the fastest one supported
+       * by the CPU is used (see cSadKernel::detect())
+       * @param instruction_set requested instruction set (falls back to a supported one)
+       */
+      void setInstructionSet( cSadKernel::eInstructionSet instruction_set );
+
+      /**
+       * @brief computes the spans and weights of all destination pixels for a source size
+       */
+      void setSourceSize( int src_width, int src_height );
+
+      /**
+       * @brief computes one row of an integral image: the prefix sum of row plus the row
+       * above (NULL for the first row), modulo 2^32
+       * @param row the row of the image
+       * @param above the previous row of the integral image or NULL
+       * @param dest the row of the integral image
+       * @param width number of pixels
+       * @param instruction_set SSE2 or SCALAR
+       */
+      static void integrateRow( const uint8_t * row, const uint32_t * above, uint32_t * dest, int width, cSadKernel::eInstructionSet instruction_set );
+
+    public: /* attributes */
+
+      /**
+       * @brief size of the destination images
+       */
+      int iWidth_;
+      int iHeight_;
+
+      /**
+       * @brief sampling of the source images
+       */
+      eMode mode_;
+
+      /**
+       * @brief size of the source image the spans were computed for
+       */
+      int iSrcWidth_;
+      int iSrcHeight_;
+
+      /**
+       * @brief the source columns and rows of every destination column and row and their
+       * weights. A weight is the overlap of a source and a destination pixel in units of 
+       * 1/iWidth_ (or 1/iHeight_) source pixels, the weights of a destination pixel sum 
+       * up to iSrcWidth_ * iSrcHeight_.
+       */
+      std::vector<tSpan> vecColumns_;
+      std::vector<tSpan> vecRows_;
+      std::vector<int> vecWeights_;
+
+      /**
+       * @brief weighted sum of the source rows of one destination row (AREA only)
+       */
+      std::vector<uint32_t> vecAccumulator_;
+
+      /**
+       * @brief the destination row if no destination image is given
+       */
+      std::vector<uint8_t> vecRow_;
+
+      /**
+       * @brief instruction set used by process() (see setInstructionSet())
+       */
+      cSadKernel::eInstructionSet instructionSet_;
+
+  };
+}
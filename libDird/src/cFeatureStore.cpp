@@ -0,0 +1,648 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+#include "cFeatureStore.h"
+#include <iostream>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _MSC_VER
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace DIRD
+{
+  static const char magic[8] = { 'D', 'I', 'R', 'D', 'F', 'E', 'A', 'T' };
+
+  // sets the size of an open file (discards everything behind)
+  static bool truncateFile( FILE * file, uint64_t size )
+  {
+    if (fflush( file ) != 0)
+    {
+      return false;
+    }
+#ifdef _MSC_VER
+    return _chsize_s( _fileno( file ), (__int64)size ) == 0;
+#else
+    return ftruncate( fileno( file ), (off_t)size ) == 0;
+#endif
+  }
+
+  // forces the data of an open file to disk
+  static bool syncFile( FILE * file )
+  {
+    if (fflush( file ) != 0)
+    {
+      return false;
+    }
+#ifdef _MSC_VER
+    return _commit( _fileno( file ) ) == 0;
+#else
+    return fsync( fileno( file ) ) == 0;
+#endif
+  }
+
+  cFeatureStore::cFeatureStore()
+    : records_(NULL),
+    mapping_(NULL),
+    mapping_size_(0),
+#ifdef _MSC_VER
+    file_handle_(INVALID_HANDLE_VALUE),
+    mapping_handle_(NULL),
+#else
+    file_descriptor_(-1),
+#endif
+    file_(NULL),
+    index_file_(NULL),
+    syncInterval_(100)
+  {
+    memset( &header_, 0, sizeof(header_) );
+  }
+
+  cFeatureStore::~cFeatureStore()
+  {
+    close();
+  }
+
+  uint32_t cFeatureStore::crc32( const void * data, size_t size, uint32_t crc )
+  {
+    static uint32_t table[256];
+    static bool initialized = false;
+    if (!initialized)
+    {
+      for (uint32_t n = 0; n < 256; ++n)
+      {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+        {
+          c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+      }
+      initialized = true;
+    }
+
+    const uint8_t * bytes = (const uint8_t *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+      crc = table[ (crc ^ bytes[i]) & 0xFF ] ^ (crc >> 8);
+    }
+    return ~crc;
+  }
+
+  int cFeatureStore::readIndex( FILE * index_file, int first_record, const uint8_t * records, int num_records )
+  {
+    // entries are appended after their records, so a torn or missing entry 
+    // (or a record that doesnt match its checksum) ends the valid part
+    int k = first_record;
+    tIndexEntry entry;
+    while (k < num_records && fread( &entry, sizeof(entry), 1, index_file ) == 1)
+    {
+      const uint8_t * record = records + (size_t)k * header_.stride;
+      uint32_t index = k;
+      if (entry.index != index || entry.checksum != crc32( &index, sizeof(index), crc32( record, header_.dim_feature ) ))
+      {
+        break;
+      }
+      k++;
+    }
+    return k;
+  }
+
+  bool cFeatureStore::mapFile()
+  {
+#ifdef _MSC_VER
+    if (mapping_ != NULL)
+    {
+      UnmapViewOfFile( mapping_ );
+      CloseHandle( mapping_handle_ );
+      mapping_ = NULL;
+      mapping_handle_ = NULL;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx( file_handle_, &file_size ) || file_size.QuadPart < (LONGLONG)sizeof(tHeader))
+    {
+      return false;
+    }
+    mapping_size_ = (size_t)file_size.QuadPart;
+    mapping_handle_ = CreateFileMapping( file_handle_, NULL, PAGE_READONLY, 0, 0, NULL );
+    if (mapping_handle_ == NULL)
+    {
+      return false;
+    }
+    mapping_ = MapViewOfFile( mapping_handle_, FILE_MAP_READ, 0, 0, 0 );
+    if (mapping_ == NULL)
+    {
+      return false;
+    }
+#else
+    if (mapping_ != NULL)
+    {
+      munmap( mapping_, mapping_size_ );
+      mapping_ = NULL;
+    }
+    struct stat file_stat;
+    if (fstat( file_descriptor_, &file_stat ) != 0 || !S_ISREG( file_stat.st_mode ) ||
+        file_stat.st_size < (off_t)sizeof(tHeader))
+    {
+      return false;
+    }
+    mapping_size_ = (size_t)file_stat.st_size;
+    mapping_ = mmap( NULL, mapping_size_, PROT_READ, MAP_SHARED, file_descriptor_, 0 );
+    if (mapping_ == MAP_FAILED)
+    {
+      mapping_ = NULL;
+      return false;
+    }
+    // the records are read front to back by the place recognizer
+    madvise( mapping_, mapping_size_, MADV_WILLNEED );
+#endif
+    return true;
+  }
+
+  bool cFeatureStore::open( string file_name )
+  {
+    close();
+    file_name_ = file_name;
+
+#ifdef _MSC_VER
+    file_handle_ = CreateFileA( file_name.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    if (file_handle_ == INVALID_HANDLE_VALUE)
+    {
+      return false;
+    }
+#else
+    file_descriptor_ = ::open( file_name.c_str(), O_RDONLY );
+    if (file_descriptor_ < 0)
+    {
+      return false;
+    }
+#endif
+    if (!mapFile())
+    {
+      close();
+      return false;
+    }
+
+    // check the header
+    memcpy( &header_, mapping_, sizeof(tHeader) );
+    if (memcmp( header_.magic, magic, sizeof(magic) ) != 0)
+    {
+      close();
+      return false;
+    }
+    if (header_.version != version_)
+    {
+      cerr << "Feature store has version " << header_.version << ", only version " << version_ << " is supported\n";
+      close();
+      return false;
+    }
+    if (header_.header_size < sizeof(tHeader) || header_.stride < header_.dim_feature || header_.stride == 0)
+    {
+      cerr << "Feature store " << file_name << " is corrupt\n";
+      close();
+      return false;
+    }
+    records_ = (const uint8_t *)mapping_ + header_.header_size;
+
+    // a store which is still being written (or whose writer died) is as 
+    // long as the valid part of its index
+    if (!header_.complete)
+    {
+      index_file_ = fopen( (file_name + ".idx").c_str(), "rb" );
+      if (index_file_ != NULL)
+      {
+        int num_records = (int)((mapping_size_ - header_.header_size) / header_.stride);
+        header_.num_features = readIndex( index_file_, 0, records_, num_records );
+      }
+    }
+
+    if (header_.header_size + header_.num_features * header_.stride > mapping_size_)
+    {
+      cerr << "Feature store " << file_name << " is truncated or corrupt\n";
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  bool cFeatureStore::refresh()
+  {
+    if (records_ == NULL)
+    {
+      return false;
+    }
+    if (header_.complete)
+    {
+      return true;
+    }
+
+    // map the grown file
+    if (!mapFile())
+    {
+      close();
+      return false;
+    }
+    tHeader header;
+    memcpy( &header, mapping_, sizeof(tHeader) );
+    records_ = (const uint8_t *)mapping_ + header_.header_size;
+    int num_records = (int)((mapping_size_ - header_.header_size) / header_.stride);
+
+    if (header.complete && header.header_size + header.num_features * header.stride <= mapping_size_)
+    {
+      // finished in the meantime
+      header_ = header;
+    }
+    else if (index_file_ != NULL || (index_file_ = fopen( (file_name_ + ".idx").c_str(), "rb" )) != NULL)
+    {
+      // new index entries (entries beyond the end of the file may be torn)
+      clearerr( index_file_ );
+      fseek( index_file_, (long)(header_.num_features * sizeof(tIndexEntry)), SEEK_SET );
+      header_.num_features = readIndex( index_file_, (int)header_.num_features, records_, num_records );
+    }
+
+    return true;
+  }
+
+  void cFeatureStore::close()
+  {
+    if (file_ != NULL)
+    {
+      finish();
+    }
+    if (index_file_ != NULL)
+    {
+      fclose( index_file_ );
+      index_file_ = NULL;
+    }
+
+#ifdef _MSC_VER
+    if (mapping_ != NULL)
+    {
+      UnmapViewOfFile( mapping_ );
+    }
+    if (mapping_handle_ != NULL)
+    {
+      CloseHandle( mapping_handle_ );
+    }
+    if (file_handle_ != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle( file_handle_ );
+    }
+    mapping_handle_ = NULL;
+    file_handle_ = INVALID_HANDLE_VALUE;
+#else
+    if (mapping_ != NULL)
+    {
+      munmap( mapping_, mapping_size_ );
+    }
+    if (file_descriptor_ >= 0)
+    {
+      ::close( file_descriptor_ );
+    }
+    file_descriptor_ = -1;
+#endif
+
+    mapping_ = NULL;
+    mapping_size_ = 0;
+    records_ = NULL;
+  }
+
+  bool cFeatureStore::create( string file_name, int dim_feature, int num_tiles_x, int num_tiles_y )
+  {
+    close();
+    file_name_ = file_name;
+
+    file_ = fopen( file_name.c_str(), "wb" );
+    index_file_ = fopen( (file_name + ".idx").c_str(), "wb" );
+    if (file_ == NULL || index_file_ == NULL)
+    {
+      close();
+      return false;
+    }
+
+    memset( &header_, 0, sizeof(header_) );
+    memcpy( header_.magic, magic, sizeof(magic) );
+    header_.version = version_;
+    header_.header_size = alignment_;
+    header_.num_features = 0;
+    header_.dim_feature = dim_feature;
+    header_.stride = (dim_feature + alignment_ - 1) / alignment_ * alignment_;
+    header_.alignment = alignment_;
+    header_.num_tiles_x = num_tiles_x;
+    header_.num_tiles_y = num_tiles_y;
+    header_.dim_tile = dim_feature / (num_tiles_x * num_tiles_y);
+    header_.tile_order = 0;
+    header_.complete = 0;
+
+    // the header is rewritten by finish() once the number of records is known
+    vector<uint8_t> header_block( header_.header_size, 0 );
+    memcpy( &header_block[0], &header_, sizeof(tHeader) );
+    if (fwrite( &header_block[0], 1, header_block.size(), file_ ) != header_block.size() || fflush( file_ ) != 0)
+    {
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  bool cFeatureStore::resume( string file_name, int dim_feature )
+  {
+    // the valid records (see open())
+    if (!open( file_name ) || getDimFeature() != dim_feature)
+    {
+      close();
+      return false;
+    }
+    int num_features = getNumFeatures();
+
+    // index entries of a finished store may be missing (e.g. converted ones)
+    int num_entries = num_features;
+    if (header_.complete)
+    {
+      FILE * index_file = fopen( (file_name + ".idx").c_str(), "rb" );
+      num_entries = index_file != NULL ? readIndex( index_file, 0, records_, num_features ) : 0;
+      if (index_file != NULL)
+      {
+        fclose( index_file );
+      }
+    }
+    vector<tIndexEntry> missing_entries;
+    for (int k = num_entries; k < num_features; ++k)
+    {
+      tIndexEntry entry;
+      entry.index = k;
+      entry.checksum = crc32( &entry.index, sizeof(entry.index), crc32( getFeature(k), header_.dim_feature ) );
+      missing_entries.push_back( entry );
+    }
+    tHeader header = header_;
+    close();
+
+    // drop everything behind the valid records and continue writing there
+    file_name_ = file_name;
+    file_ = fopen( file_name.c_str(), "r+b" );
+    index_file_ = fopen( (file_name + ".idx").c_str(), "r+b" );
+    if (index_file_ == NULL)
+    {
+      index_file_ = fopen( (file_name + ".idx").c_str(), "w+b" );
+    }
+    header_ = header;
+    header_.num_features = num_features;
+    header_.complete = 0;
+    if (file_ == NULL || index_file_ == NULL ||
+        !truncateFile( file_, header_.header_size + (uint64_t)num_features * header_.stride ) ||
+        !truncateFile( index_file_, (uint64_t)num_entries * sizeof(tIndexEntry) ) ||
+        fseek( file_, 0, SEEK_SET ) != 0 || fwrite( &header_, sizeof(tHeader), 1, file_ ) != 1 ||
+        fseek( file_, 0, SEEK_END ) != 0 || fseek( index_file_, 0, SEEK_END ) != 0)
+    {
+      if (file_ != NULL)
+      {
+        fclose( file_ );
+        file_ = NULL;
+      }
+      close();
+      return false;
+    }
+    if (!missing_entries.empty() &&
+        fwrite( &missing_entries[0], sizeof(tIndexEntry), missing_entries.size(), index_file_ ) != missing_entries.size())
+    {
+      fclose( file_ );
+      file_ = NULL;
+      close();
+      return false;
+    }
+
+    return sync();
+  }
+
+  bool cFeatureStore::append( const uint8_t * feature_vector )
+  {
+    if (file_ == NULL)
+    {
+      return false;
+    }
+
+    // the record first, then its index entry which makes it valid
+    static const uint8_t padding[ alignment_ ] = { 0 };
+    if (fwrite( feature_vector, 1, header_.dim_feature, file_ ) != header_.dim_feature ||
+        fwrite( padding, 1, header_.stride - header_.dim_feature, file_ ) != header_.stride - header_.dim_feature ||
+        fflush( file_ ) != 0)
+    {
+      return false;
+    }
+
+    tIndexEntry entry;
+    entry.index = (uint32_t)header_.num_features;
+    entry.checksum = crc32( &entry.index, sizeof(entry.index), crc32( feature_vector, header_.dim_feature ) );
+    if (fwrite( &entry, sizeof(entry), 1, index_file_ ) != 1 || fflush( index_file_ ) != 0)
+    {
+      return false;
+    }
+
+    header_.num_features++;
+    if (header_.num_features % syncInterval_ == 0)
+    {
+      return sync();
+    }
+    return true;
+  }
+
+  bool cFeatureStore::sync()
+  {
+    if (file_ == NULL)
+    {
+      return false;
+    }
+    // the records have to be on disk before the index entries referencing them
+    return syncFile( file_ ) && syncFile( index_file_ );
+  }
+
+  bool cFeatureStore::finish()
+  {
+    if (file_ == NULL)
+    {
+      return false;
+    }
+
+    header_.complete = 1;
+    bool success = sync() && fseek( file_, 0, SEEK_SET ) == 0 &&
+      fwrite( &header_, sizeof(tHeader), 1, file_ ) == 1 && syncFile( file_ );
+    success = (fclose( file_ ) == 0) && success;
+    file_ = NULL;
+    if (index_file_ != NULL)
+    {
+      fclose( index_file_ );
+      index_file_ = NULL;
+    }
+    return success;
+  }
+
+  bool cFeatureStore::loadTextFeature( string file_name, uint8_t * feature, int dim, vector<char> * buffer )
+  {
+    FILE * file = fopen( file_name.c_str(), "rb" );
+    if (file == NULL)
+    {
+      return false;
+    }
+
+    // read the whole file at once
+    vector<char> local_buffer;
+    vector<char> & text = buffer != NULL ? *buffer : local_buffer;
+    size_t size = 0;
+    text.resize( max( (size_t)(4 * dim + 64), text.size() ) );
+    while (true)
+    {
+      size += fread( &text[size], 1, text.size() - size, file );
+      if (size < text.size())
+      {
+        break;
+      }
+      text.resize( 2 * text.size() );
+    }
+    fclose( file );
+
+    return parseTextFeature( &text[0], size, feature, dim );
+  }
+
+  bool cFeatureStore::parseTextFeature( const char * text, size_t size, uint8_t * feature, int dim )
+  {
+    const char * p = text;
+    const char * end = text + size;
+    for (int i = 0; i < dim; ++i)
+    {
+      // values are separated by white space, only the first line counts
+      while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+      {
+        ++p;
+      }
+      if (p == end || *p == '\n')
+      {
+        cerr << "Trying to load a feature vector which is lower dimensional than " << dim << "\n";
+        return false;
+      }
+
+      bool negative = false;
+      if (*p == '-' || *p == '+')
+      {
+        negative = (*p == '-');
+        ++p;
+      }
+      if (p == end || *p < '0' || *p > '9')
+      {
+        cerr << "Trying to load a feature vector which contains something else than integers\n";
+        return false;
+      }
+      int v = 0;
+      for (; p < end && *p >= '0' && *p <= '9'; ++p)
+      {
+        v = min( 10 * v + (*p - '0'), 256 );
+      }
+      if (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+      {
+        cerr << "Trying to load a feature vector which contains something else than integers\n";
+        return false;
+      }
+
+      if (v > 255 || (negative && v != 0))
+      {
+        cerr << "Trying to load a feature vector which is not uint8_t\n";
+        return false;
+      }
+      feature[i] = (uint8_t) v;
+    }
+
+    return true;
+  }
+
+  int cFeatureStore::loadTextFolder( string dir, uint8_t * feature_vectors, int max_num_features, int dim, int num_threads )
+  {
+#ifdef _OPENMP
+    if (num_threads <= 0)
+    {
+      num_threads = omp_get_max_threads();
+    }
+#else
+    num_threads = 1;
+#endif
+
+    // The number of files is unknown, hence they are loaded in batches. Files
+    // of a batch are spread over the threads. Loading stops at the first file
+    // that is missing (or invalid), files behind it are not used.
+    int batch_size = 64 * num_threads;
+    int num_features = 0;
+    vector<char> loaded( batch_size );
+    while (num_features < max_num_features)
+    {
+      int batch_begin = num_features;
+      int batch_end = min( batch_begin + batch_size, max_num_features );
+
+#pragma omp parallel num_threads(num_threads)
+      {
+        vector<char> buffer;
+#pragma omp for schedule(dynamic,4)
+        for (int i = batch_begin; i < batch_end; ++i)
+        {
+          char base_name[256]; 
+#ifdef _MSC_VER
+          sprintf_s(base_name, 256, "%06d.txt",i);
+#else
+          sprintf(base_name,"%06d.txt",i);
+#endif
+          loaded[ i - batch_begin ] = loadTextFeature( dir + "/" + base_name, &feature_vectors[ (size_t)i * dim ], dim, &buffer );
+        }
+      }
+
+      while (num_features < batch_end && loaded[ num_features - batch_begin ])
+      {
+        num_features++;
+      }
+      cout << "\rLoaded " << num_features << " features";
+      cout.flush();
+      if (num_features < batch_end)
+      {
+        break;
+      }
+    }
+
+    return num_features;
+  }
+}
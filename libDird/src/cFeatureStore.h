@@ -0,0 +1,321 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#pragma once
+
+#if defined(_MSC_VER) && _MSC_VER <= 1500
+typedef unsigned char uint8_t;
+typedef unsigned int uint32_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace DIRD
+{
+
+  /*@class cFeatureStore
+   *
+   * A single binary file holding the feature vectors of a whole sequence.
+   * It starts with a header (tHeader) followed by one record per frame. Every
+   * record is padded to a multiple of alignment_ bytes and the header is
+   * alignment_ bytes large, hence all records are 64 byte aligned when the
+   * file is memory mapped (see open()). If a record needs no padding (e.g.
+   * 3456 = 54 * 64 for the default 4x4 tiling) the mapped records can be
+   * passed to cPlaceRecognizer without copying (see isContiguous()).
+   *
+   * Files are written with create(), append() and finish(). Values are stored
+   * in the byte order of the machine (little endian on x86).
+   *
+   * While a store is written it is an append-only log: every record gets an
+   * entry (its index and a CRC-32) in a sidecar index file (file name + ".idx").
+   * Until finish() the index decides which records are valid, hence a writer 
+   * that died can continue after the last intact record (see resume()) and a
+   * reader can follow a store that is still being written (see refresh()).
+   *
+   */
+  class cFeatureStore
+  {
+
+    public: /* public classes/enums/types etc... */
+
+      /**
+       * @brief file header (exactly alignment_ bytes)
+       */
+      struct tHeader
+      {
+        char magic[8];          // "DIRDFEAT"
+        uint32_t version;       // version_
+        uint32_t header_size;   // offset of the first record in bytes
+        uint64_t num_features;  // number of records
+        uint32_t dim_feature;   // dimension of one feature vector
+        uint32_t stride;        // size of one record in bytes (dim_feature padded to alignment)
+        uint32_t alignment;     // alignment of the records in bytes
+        uint32_t num_tiles_x;   // tiling of the image (number of tiles horizontally)
+        uint32_t num_tiles_y;   // tiling of the image (number of tiles vertically)
+        uint32_t dim_tile;      // dimension of the DIRD feature of one tile
+        uint32_t tile_order;    // 0: tiles ordered x outer, y inner (see compute_features)
+        uint32_t complete;      // 1 after finish(), num_features is valid then (the index otherwise)
+        uint32_t reserved[2];
+      };
+
+      /**
+       * @brief an entry of the index file (one per record)
+       */
+      struct tIndexEntry
+      {
+        uint32_t index;         // index of the record
+        uint32_t checksum;      // CRC-32 of the feature vector and index
+      };
+
+    public: /* public methods */
+
+      /**
+       * construct a cFeatureStore object from scratch
+       */
+      cFeatureStore();
+
+      /**
+       * destruct a cFeatureStore object (closes open files)
+       */
+      ~cFeatureStore();
+
+      /**
+       * @brief memory maps an existing store (read only)
+       * @return true on success, false if the file cannot be mapped or is no valid store
+       * @param file_name name of file
+       */
+      bool open( std::string file_name );
+
+      /**
+       * @brief (re-)maps the whole file opened by open()
+       * @return true on success, false otherwise
+       */
+      bool mapFile();
+
+      /**
+       * @brief maps the records which were appended to the store since open() or the
+       * last refresh(), used to follow a store that is still being written. 
+       * Pointers returned by getFeature() become invalid.
+       * @return true on success, false otherwise
+       */
+      bool refresh();
+
+      /**
+       * @brief unmaps the store or finishes a store that is being written
+       */
+      void close();
+
+      /**
+       * @brief creates a new (empty) store. Feature vectors are added with append()
+       * @return true on success, false otherwise
+       * @param file_name name of file (overwritten)
+       * @param dim_feature dimension of one feature vector
+       * @param num_tiles_x number of tiles horizontally (informational)
+       * @param num_tiles_y number of tiles vertically (informational)
+       */
+      bool create( std::string file_name, int dim_feature, int num_tiles_x = 4, int num_tiles_y = 4 );
+
+      /**
+       * @brief opens an existing store for appending. Records after the last one
+       * with a valid index entry (e.g. of a crashed writer) are discarded.
+       * @return true on success, false if the file doesnt exist or is no valid store
+       * @param file_name name of file
+       * @param dim_feature expected dimension of one feature vector
+       */
+      bool resume( std::string file_name, int dim_feature );
+
+      /**
+       * @brief appends a feature vector to a store opened by create() or resume(). The
+       * record is visible to readers right away and durable after the next sync().
+       * @return true on success, false otherwise
+       * @param feature_vector dim_feature values
+       */
+      bool append( const uint8_t * feature_vector );
+
+      /**
+       * @brief forces the records appended so far to disk (called every syncInterval_ records)
+       * @return true on success, false otherwise
+       */
+      bool sync();
+
+      /**
+       * @brief writes the final header and closes a store opened by create()
+       * @return true on success, false otherwise
+       */
+      bool finish();
+
+      /**
+       * @brief pointer to the record of a feature vector of a mapped store
+       * @return pointer to dim_feature values
+       * @param i index of the feature vector
+       */
+      inline const uint8_t * getFeature( int i ) const
+      {
+        return records_ + (size_t)i * header_.stride;
+      }
+
+      /**
+       * @brief number of feature vectors of the store
+       */
+      inline int getNumFeatures() const
+      {
+        return (int)header_.num_features;
+      }
+
+      /**
+       * @brief dimension of the feature vectors of the store
+       */
+      inline int getDimFeature() const
+      {
+        return (int)header_.dim_feature;
+      }
+
+      /**
+       * @brief true if the records are not padded, i.e. feature vector i starts at
+       * getFeature(0) + i * dim_feature (the layout expected by cPlaceRecognizer)
+       */
+      inline bool isContiguous() const
+      {
+        return header_.stride == header_.dim_feature;
+      }
+
+      /**
+       * @brief reads a feature vector from a text file written by older versions of
+       * compute_features (one line of space separated integers)
+       * @return true on success, false if the file doesnt exist, is lower dimensional
+       * or contains values outside of 0 ... 255
+       * @param file_name name of file
+       * @param feature destination (dim values)
+       * @param dim dimension of the feature vector
+       * @param buffer buffer for the file content (reused between calls, may be NULL)
+       */
+      static bool loadTextFeature( std::string file_name, uint8_t * feature, int dim, std::vector<char> * buffer = NULL );
+
+      /**
+       * @brief parses the first line of a text feature file (see loadTextFeature())
+       * @return true on success, false if there are less than dim values, a value is
+       * outside of 0 ... 255 or no integer. Further values are ignored.
+       * @param text content of the file
+       * @param size number of characters
+       * @param feature destination (dim values)
+       * @param dim dimension of the feature vector
+       */
+      static bool parseTextFeature( const char * text, size_t size, uint8_t * feature, int dim );
+
+      /**
+       * @brief loads the text feature files 000000.txt, 000001.txt, ... of a folder in
+       * parallel until the first file that is missing or invalid
+       * @return number of feature vectors loaded
+       * @param dir the folder
+       * @param feature_vectors destination (max_num_features * dim values)
+       * @param max_num_features maximal number of feature vectors
+       * @param dim dimension of the feature vectors
+       * @param num_threads number of threads (0 means one per core)
+       */
+      static int loadTextFolder( std::string dir, uint8_t * feature_vectors, int max_num_features, int dim, int num_threads = 0 );
+
+      /**
+       * @brief computes the CRC-32 (polynomial 0xEDB88320) of a block of data
+       * @return updated checksum
+       * @param data the data
+       * @param size number of bytes
+       * @param crc checksum of the preceding data (0 initially)
+       */
+      static uint32_t crc32( const void * data, size_t size, uint32_t crc = 0 );
+
+      /**
+       * @brief reads the valid entries of the index file of the store
+       * @return number of records with valid entries, starting at first_record
+       * @param index_file the open index file (positioned at first_record)
+       * @param first_record the first record to check
+       * @param records the records (at least first_record records)
+       * @param num_records number of records in records
+       */
+      int readIndex( FILE * index_file, int first_record, const uint8_t * records, int num_records );
+
+    public: /* attributes */
+
+      /**
+       * @brief version of the file format written by create()
+       */
+      static const uint32_t version_ = 1;
+
+      /**
+       * @brief alignment of the records in bytes
+       */
+      static const uint32_t alignment_ = 64;
+
+      /**
+       * @brief header of the open store
+       */
+      tHeader header_;
+
+      /**
+       * @brief first record of a mapped store (NULL if none is mapped)
+       */
+      const uint8_t * records_;
+
+      /**
+       * @brief the memory mapped file (NULL if none is mapped) and its size in bytes
+       */
+      void * mapping_;
+      size_t mapping_size_;
+
+      /**
+       * @brief platform handles of the mapped file (file descriptor or HANDLEs)
+       */
+#ifdef _MSC_VER
+      void * file_handle_;
+      void * mapping_handle_;
+#else
+      int file_descriptor_;
+#endif
+
+      /**
+       * @brief file written by create() and append() (NULL if none)
+       */
+      FILE * file_;
+
+      /**
+       * @brief index file written by append() or followed by refresh() (NULL if none)
+       */
+      FILE * index_file_;
+
+      /**
+       * @brief name of the store
+       */
+      std::string file_name_;
+
+      /**
+       * @brief number of records after which append() calls sync()
+       */
+      int syncInterval_;
+
+  };
+}
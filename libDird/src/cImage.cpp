@@ -102,6 +102,34 @@ namespace DIRD {
 		return true;
 	}
 
+	bool cImage::loadInto(const std::string& filename, std::vector<BYTE>& buffer, tView& view) {
+		view = tView();
+
+		cImage image;
+		if (image.load(filename) == false) {
+			return false;
+		}
+
+		int width = image.getWidth();
+		int height = image.getHeight();
+		if (buffer.size() < (size_t)width * height) {
+			buffer.resize((size_t)width * height);
+		}
+
+		// copy whole scanlines, dropping the padding of the bitmap
+		BYTE* bits = FreeImage_GetBits(image.image_);
+		for (int v = 0; v < height; ++v) {
+			memcpy(&buffer[(size_t)v * width], bits + (size_t)v * image.pitch_, width);
+		}
+
+		view.data = buffer.empty() ? NULL : &buffer[0];
+		view.pitch = width;
+		view.width = width;
+		view.height = height;
+		view.bottomUp = true;
+		return true;
+	}
+
 	bool cImage::write(const std::string& filename) const {
 		assert(image_ != NULL);
 
@@ -134,5 +162,18 @@ namespace DIRD {
 
 		return height_;
 	}
+
+	cImage::tView cImage::getView() const {
+		assert(image_ != NULL);
+		assert(bpp_ == 1);
+
+		tView view;
+		view.data = FreeImage_GetBits(image_);
+		view.pitch = pitch_;
+		view.width = width_;
+		view.height = height_;
+		view.bottomUp = true;
+		return view;
+	}
 }
 
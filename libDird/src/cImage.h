@@ -24,6 +24,7 @@ Street, Fifth Floor, Boston, MA 02110-1301, USA
 
 #pragma once
 #include <string>
+#include <vector>
 #include <string.h>
 #include <cassert>
 #include <FreeImage.h>
@@ -35,6 +36,22 @@ namespace DIRD {
 class cImage
 {
 public:
+	// read-only view of the pixels of an 8 bit grey value image
+	struct tView {
+		const BYTE* data;	// scanline 0
+		int pitch;			// bytes from one scanline to the next
+		int width;
+		int height;
+		bool bottomUp;		// scanline 0 is the bottom row of the picture (as in FreeImage)
+
+		tView() : data(NULL), pitch(0), width(0), height(0), bottomUp(true) {}
+
+		// scanline v, i.e. the row read by getPixel(u, v)
+		const BYTE* row(const int v) const {
+			return data + v * pitch;
+		}
+	};
+
 	cImage();
 	cImage(const std::string& filename);
 	cImage(const int u, const int v, const int bpp);
@@ -46,12 +63,19 @@ public:
 	bool create(const int u, const int v, const int bpp);
 	bool load(const std::string& filename);
 
+	// decodes an 8 bit grey value image into caller owned memory (scanlines in the 
+	// order of getPixel(), no padding), the buffer is only grown and can be reused
+	static bool loadInto(const std::string& filename, std::vector<BYTE>& buffer, tView& view);
+
 	bool write(const std::string& filename) const;
 
 	void destroy();
 	
 	int getWidth() const;
 	int getHeight() const;
+
+	// view of the pixels of a loaded 8 bit image, valid until it is destroyed
+	tView getView() const;
 	
 	template <typename T>
 	void getPixel(const int u, const int v, T& pixelData) const {
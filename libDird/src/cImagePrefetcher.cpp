@@ -0,0 +1,153 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+#include "cImagePrefetcher.h"
+
+#include <stdio.h>
+#include <chrono>
+
+using namespace std;
+
+namespace DIRD
+{
+
+  cImagePrefetcher::cImagePrefetcher( const vector<string> & file_names, int num_buffers, int num_threads )
+    : vecFileNames_(file_names),
+    vecImages_(num_buffers),
+    vecBuffers_(num_buffers),
+    vecLoaded_(num_buffers, false),
+    nextLoad_(0),
+    nextRelease_(0),
+    stop_(false),
+    waitTime_(0)
+  {
+    // initialises FreeImage before the threads load images
+    cImage image_library;
+
+    for (int t = 0; t < num_threads; ++t)
+    {
+      vecThreads_.push_back( thread( &cImagePrefetcher::loadImages, this ) );
+    }
+  }
+
+  cImagePrefetcher::~cImagePrefetcher()
+  {
+    {
+      lock_guard<mutex> lock( mutex_ );
+      stop_ = true;
+    }
+    released_.notify_all();
+    for (size_t t = 0; t < vecThreads_.size(); ++t)
+    {
+      vecThreads_[t].join();
+    }
+  }
+
+  void cImagePrefetcher::loadImages()
+  {
+    int num_buffers = (int)vecImages_.size();
+    for (;;)
+    {
+      // the next image whose buffer is free
+      int n;
+      {
+        unique_lock<mutex> lock( mutex_ );
+        while (!stop_ && nextLoad_ < getNumImages() && nextLoad_ >= nextRelease_ + num_buffers)
+        {
+          released_.wait( lock );
+        }
+        if (stop_ || nextLoad_ >= getNumImages())
+        {
+          return;
+        }
+        n = nextLoad_++;
+      }
+
+      // decode it without holding the lock
+      tImage & image = vecImages_[ n % num_buffers ];
+      image.valid = cImage::loadInto( vecFileNames_[n], vecBuffers_[ n % num_buffers ], image.view );
+
+      {
+        lock_guard<mutex> lock( mutex_ );
+        vecLoaded_[ n % num_buffers ] = true;
+      }
+      loaded_.notify_all();
+    }
+  }
+
+  const cImagePrefetcher::tImage & cImagePrefetcher::get( int n )
+  {
+    int slot = n % (int)vecImages_.size();
+    unique_lock<mutex> lock( mutex_ );
+    if (!vecLoaded_[slot])
+    {
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      while (!vecLoaded_[slot])
+      {
+        loaded_.wait( lock );
+      }
+      waitTime_ += chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    }
+    return vecImages_[slot];
+  }
+
+  void cImagePrefetcher::release()
+  {
+    {
+      lock_guard<mutex> lock( mutex_ );
+      vecLoaded_[ nextRelease_ % (int)vecImages_.size() ] = false;
+      nextRelease_++;
+    }
+    released_.notify_all();
+  }
+
+  double cImagePrefetcher::getWaitTime()
+  {
+    lock_guard<mutex> lock( mutex_ );
+    return waitTime_;
+  }
+
+  string cImagePrefetcher::fileName( const string & dir, int i )
+  {
+    const int bufSize = 256;
+    char base_name[bufSize];
+
+#ifdef _MSC_VER
+    sprintf_s(base_name, bufSize, "%06d.png", i);
+#else
+    sprintf(base_name, "%06d.png", i);
+#endif
+
+    return dir + "/" + base_name;
+  }
+
+  vector<string> cImagePrefetcher::sequence( const string & dir, int first, int last )
+  {
+    vector<string> file_names;
+    for (int i = first; i <= last; ++i)
+    {
+      file_names.push_back( fileName( dir, i ) );
+    }
+    return file_names;
+  }
+}
@@ -0,0 +1,182 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#pragma once
+
+#if defined(_MSC_VER) && _MSC_VER <= 1500
+typedef unsigned char uint8_t;
+#else
+#include <stdint.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "cImage.h"
+
+namespace DIRD
+{
+
+  /*@class cImagePrefetcher
+   *
+   * Loads a list of grey value images (see cImage) on background threads
+   * ahead of their use, so that decoding overlaps with the processing of the
+   * previous images.
+   *
+   * The images are decoded (see cImage::loadInto()) into a ring of num_buffers
+   * reusable buffers: image n goes to buffer n % num_buffers, which is free
+   * once image n - num_buffers was released. Hence at most num_buffers images
+   * are held in memory.
+   *
+   * Images are consumed in the order of the list: get() waits until an image
+   * is loaded and release() hands back the oldest image. The time get() waits
+   * is accumulated (see getWaitTime()), i.e. the time the consumer is bound
+   * by I/O.
+   *
+   */
+  class cImagePrefetcher
+  {
+
+    public: /* public classes/enums/types etc... */
+
+      /**
+       * @brief a loaded image
+       */
+      struct tImage
+      {
+        cImage::tView view;     // the pixels (rows counted like by cImage::getPixel())
+        bool valid;             // false if the file couldnt be loaded
+      };
+
+    public: /* public methods */
+
+      /**
+       * construct a cImagePrefetcher object and start loading
+       * @param file_names the images in the order they will be used
+       * @param num_buffers number of images loaded ahead (and held in memory)
+       * @param num_threads number of threads loading images
+       */
+      cImagePrefetcher( const std::vector<std::string> & file_names, int num_buffers = 8, int num_threads = 2 );
+
+      /**
+       * destruct a cImagePrefetcher object (stops loading)
+       */
+      ~cImagePrefetcher();
+
+      /**
+       * @brief waits until an image is loaded
+       * @return the image, valid until it is released
+       * @param n index into the list of file names (at least the oldest image which was
+       * not released yet and less than that plus num_buffers)
+       */
+      const tImage & get( int n );
+
+      /**
+       * @brief releases the oldest image which was not released yet, its buffer is reused
+       */
+      void release();
+
+      /**
+       * @brief number of images in the list
+       */
+      inline int getNumImages() const
+      {
+        return (int)vecFileNames_.size();
+      }
+
+      /**
+       * @brief time in seconds get() waited for images to be loaded
+       */
+      double getWaitTime();
+
+      /**
+       * @brief the file name of image i of a sequence (six digits, e.g. dir/000042.png)
+       * @return the file name
+       * @param dir folder of the sequence
+       * @param i index of the image
+       */
+      static std::string fileName( const std::string & dir, int i );
+
+      /**
+       * @brief the file names first.png, first+1.png, ..., last.png of a sequence
+       * (six digits, e.g. dir/000042.png)
+       * @return the file names
+       * @param dir folder of the sequence
+       * @param first index of the first image
+       * @param last index of the last image
+       */
+      static std::vector<std::string> sequence( const std::string & dir, int first, int last );
+
+      /**
+       * @brief loads images as long as there are free buffers (run by the threads)
+       */
+      void loadImages();
+
+    public: /* attributes */
+
+      /**
+       * @brief the images in the order they will be used
+       */
+      std::vector<std::string> vecFileNames_;
+
+      /**
+       * @brief the ring of images and their memory
+       */
+      std::vector<tImage> vecImages_;
+      std::vector< std::vector<BYTE> > vecBuffers_;
+
+      /**
+       * @brief true for the buffers whose image is completely loaded
+       */
+      std::vector<bool> vecLoaded_;
+
+      /**
+       * @brief next image to be loaded and oldest image which was not released yet
+       */
+      int nextLoad_;
+      int nextRelease_;
+
+      /**
+       * @brief set by the destructor to stop the threads
+       */
+      bool stop_;
+
+      /**
+       * @brief time in seconds get() waited
+       */
+      double waitTime_;
+
+      /**
+       * @brief the threads loading images and their synchronisation
+       */
+      std::vector<std::thread> vecThreads_;
+      std::mutex mutex_;
+      std::condition_variable loaded_;
+      std::condition_variable released_;
+
+  };
+}
@@ -0,0 +1,253 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+#include "cOnlinePlaceRecognizer.h"
+#include <algorithm>
+
+#ifdef _MSC_VER
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+using namespace std;
+
+namespace DIRD
+{
+  // wall clock time in seconds
+  static double getTime()
+  {
+#ifdef _MSC_VER
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timeval TIME;
+    gettimeofday(&TIME, NULL);
+    return TIME.tv_sec + ((double) TIME.tv_usec)/1000000.0;
+#endif
+  }
+
+  // orders column entries by row
+  static inline bool lessRow( const cOnlinePlaceRecognizer::tEntry & entry, int i )
+  {
+    return entry.i < i;
+  }
+
+  cOnlinePlaceRecognizer::cOnlinePlaceRecognizer( int dim_feature, int safety_margin, int segment_length, int non_max )
+    : placeRecognizer_(NULL, 0, dim_feature),
+    dim_feature_(dim_feature),
+    safety_margin_(safety_margin),
+    segment_length_(segment_length),
+    non_max_(non_max),
+    num_frames_(0),
+    latencyLast_(0),
+    latencyMax_(0),
+    latencySum_(0)
+  {
+
+  }
+
+  cOnlinePlaceRecognizer::~cOnlinePlaceRecognizer()
+  {
+
+  }
+
+  float cOnlinePlaceRecognizer::at( const deque<tColumn> & columns, int first_column, int i, int j )
+  {
+    if (j < first_column || j >= first_column + (int)columns.size())
+    {
+      return 0;
+    }
+    const tColumn & column = columns[ j - first_column ];
+    tColumn::const_iterator iter = lower_bound( column.begin(), column.end(), i, lessRow );
+    if (iter == column.end() || iter->i != i)
+    {
+      return 0;
+    }
+    return iter->value;
+  }
+
+  bool cOnlinePlaceRecognizer::addFrame( const uint8_t * feature_vector, vector<tLoopClosure> & loop_closures )
+  {
+    double time_start = getTime();
+
+    // the parameters of the similarity function may be changed until the first frame
+    if (num_frames_ == 0)
+    {
+      placeRecognizer_.initSimilarityLut();
+    }
+
+    int n = num_frames_++;
+    vecFeatures_.insert( vecFeatures_.end(), feature_vector, feature_vector + dim_feature_ );
+    placeRecognizer_.feature_vectors_ = &vecFeatures_[0];
+
+    // new column n of the similarity matrix: distances to all frames at least
+    // safety_margin_ older. Distances beyond maxDistance_ are discarded early.
+    int num_rows = max( 0, n - safety_margin_ + 1 );
+    long max_distance = placeRecognizer_.maxDistance_;
+    vecDistances_.resize( num_rows );
+#pragma omp parallel for num_threads(placeRecognizer_.getNumThreads()) if(num_rows > 1024)
+    for (int i = 0; i < num_rows; ++i)
+    {
+      int depth;
+      vecDistances_[i] = placeRecognizer_.distBounded( i, n, max_distance, depth );
+    }
+
+    tColumn similarity_column;
+    for (int i = 0; i < num_rows; ++i)
+    {
+      if (vecDistances_[i] <= max_distance)
+      {
+        tEntry entry = { i, placeRecognizer_.vecSimilarityLut_[ vecDistances_[i] ] };
+        similarity_column.push_back( entry );
+      }
+    }
+    dqSimilarityColumns_.push_back( similarity_column );
+    if ((int)dqSimilarityColumns_.size() > segment_length_)
+    {
+      dqSimilarityColumns_.pop_front();
+    }
+
+    // segment scores of the new column (see cPlaceRecognizer::postProcessSimilarities())
+    float tau_3 = 0.05f;
+    float tau_2 = tau_3;
+    tColumn dp_column;
+    for (size_t e = 0; e < similarity_column.size(); ++e)
+    {
+      if (similarity_column[e].value < tau_2)
+      {
+        continue;
+      }
+      float score = segmentScore( similarity_column[e].i, n, similarity_column[e].value );
+      if (score > tau_3 * segment_length_)
+      {
+        tEntry entry = { similarity_column[e].i, score };
+        dp_column.push_back( entry );
+      }
+    }
+    dqDpColumns_.push_back( dp_column );
+    if ((int)dqDpColumns_.size() > 4 * non_max_ - 3)
+    {
+      dqDpColumns_.pop_front();
+    }
+
+    // all windows reaching column n-2*(non_max_-1) are complete now
+    if (n - 2 * (non_max_ - 1) >= 0)
+    {
+      suppressNonMaxima( n - 2 * (non_max_ - 1), loop_closures );
+    }
+
+    latencyLast_ = getTime() - time_start;
+    latencyMax_ = max( latencyMax_, latencyLast_ );
+    latencySum_ += latencyLast_;
+
+    return true;
+  }
+
+  bool cOnlinePlaceRecognizer::flush( vector<tLoopClosure> & loop_closures )
+  {
+    // columns after the last frame are empty
+    for (int j = max( 0, num_frames_ - 2 * (non_max_ - 1) ); j < num_frames_; ++j)
+    {
+      suppressNonMaxima( j, loop_closures );
+    }
+    return true;
+  }
+
+  float cOnlinePlaceRecognizer::segmentScore( int i, int j, float value )
+  {
+    // the similarities of the band of the segment ending in (i,j) (see 
+    // cPlaceRecognizer::dynamicProgrammingBand()) are gathered first
+    int width = 3 * segment_length_ + 1;
+    int row_begin = i - 3 * segment_length_;
+    int first_column = num_frames_ - (int)dqSimilarityColumns_.size();
+
+    vecSimilarityBand_.assign( segment_length_ * width, 0.0f );
+    vecDpBand_.assign( segment_length_ * width, 0.0f );
+    for (int t = 1; t < segment_length_ && j - t >= first_column; ++t)
+    {
+      const tColumn & column = dqSimilarityColumns_[ j - t - first_column ];
+      tColumn::const_iterator iter = lower_bound( column.begin(), column.end(), max( 0, row_begin ), lessRow );
+      for (; iter != column.end() && iter->i <= i; ++iter)
+      {
+        vecSimilarityBand_[ t * width + iter->i - row_begin ] = iter->value;
+      }
+    }
+
+    return cPlaceRecognizer::dynamicProgrammingBand( &vecSimilarityBand_[0], &vecDpBand_[0], i, segment_length_, 
+        min( segment_length_ - 1, j ), value );
+  }
+
+  float cOnlinePlaceRecognizer::windowThreshold( int first_column, int i, int j, vector<float> & values )
+  {
+    // the window along the anti-diagonal through (i,j)
+    values.resize( 2 * non_max_ - 1 );
+    for (int k = -non_max_ + 1; k < non_max_; ++k)
+    {
+      values[ k + non_max_ - 1 ] = at( dqDpColumns_, first_column, i - k, j + k );
+    }
+    if (values.size() < 2)
+    {
+      return 0;
+    }
+    nth_element( values.begin(), values.end() - 2, values.end() );
+    return values[ values.size() - 2 ];
+  }
+
+  void cOnlinePlaceRecognizer::suppressNonMaxima( int j, vector<tLoopClosure> & loop_closures )
+  {
+    int first_column = num_frames_ - (int)dqDpColumns_.size();
+    if (j < first_column)
+    {
+      return;
+    }
+
+    const tColumn & column = dqDpColumns_[ j - first_column ];
+    vector<float> vecVals;
+    for (size_t e = 0; e < column.size(); ++e)
+    {
+      int i = column[e].i;
+
+      // keep the entry if it is among the top 2 of every window it lies in, i.e.
+      // of the windows centred on the entries within non_max-1 places
+      bool suppressed = false;
+      for (int k = -non_max_ + 1; k < non_max_ && !suppressed; ++k)
+      {
+        if (at( dqDpColumns_, first_column, i - k, j + k ) != 0)
+        {
+          suppressed = column[e].value < windowThreshold( first_column, i - k, j + k, vecVals );
+        }
+      }
+      if (suppressed)
+      {
+        continue;
+      }
+
+      tLoopClosure loop_closure = { i, j, column[e].value };
+      loop_closures.push_back( loop_closure );
+    }
+  }
+}
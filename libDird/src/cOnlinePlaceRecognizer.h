@@ -0,0 +1,223 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#pragma once
+
+#if _MSC_VER <= 1500
+typedef unsigned char uint8_t;
+#else
+#include <stdint.h>
+#endif
+
+#include <vector>
+#include <deque>
+
+#include "cPlaceRecognizer.h"
+
+namespace DIRD
+{
+
+  /*@class cOnlinePlaceRecognizer
+   *
+   * Incremental version of cPlaceRecognizer for live operation. Frames are
+   * added one after another (see addFrame()) and every call returns the loop
+   * closures which were confirmed by that frame.
+   *
+   * A new frame n only adds column n to the similarity matrix (all frames at
+   * least safety_margin older). The segment scores of column n only depend on
+   * the last segment_length columns and are identical to those of
+   * cPlaceRecognizer::postProcessSimilarities(). Only these columns are kept.
+   *
+   * Non-maxima suppression works along anti-diagonals like 
+   * cPlaceRecognizer::computeLoops(): every segment score is the centre of a 
+   * window of non_max-1 places to either side, and a segment score is a loop 
+   * closure if it is at least as large as the second largest score of every
+   * window it lies in. The windows reaching column j end at column 
+   * j+2*(non_max-1), hence a loop closure of column j is confirmed when that
+   * frame arrives.
+   *
+   */
+  class cOnlinePlaceRecognizer
+  {
+
+    public: /* public classes/enums/types etc... */
+
+      /**
+       * @brief an entry of a column of a sparse matrix
+       */
+      struct tEntry
+      {
+        int i;        // row
+        float value;
+      };
+
+      /**
+       * @brief a sparse column, entries sorted by row
+       */
+      typedef std::vector<tEntry> tColumn;
+
+      /**
+       * @brief a confirmed loop closure between frames i and j (i < j)
+       */
+      struct tLoopClosure
+      {
+        int i;
+        int j;
+        float score;
+      };
+
+    public: /* public methods */
+
+      /**
+       * construct a cOnlinePlaceRecognizer object from scratch
+       * @param dim_feature dimension of one feature vector
+       * @param safety_margin minimum number of frames for a loop (see cPlaceRecognizer::computePairwiseSimilarity())
+       * @param segment_length length of segments that shall be matched (see cPlaceRecognizer::postProcessSimilarities())
+       * @param non_max size of non-maxima supression region (see cPlaceRecognizer::computeLoops())
+       */
+      cOnlinePlaceRecognizer( int dim_feature, int safety_margin = 200, int segment_length = 20, int non_max = 60 );
+
+      /**
+       * destruct a cOnlinePlaceRecognizer object
+       */
+      ~cOnlinePlaceRecognizer();
+
+      /**
+       * @brief adds the next frame of the sequence
+       * @return true on success, false otherwise
+       * @param feature_vector feature vector of the frame (dim_feature_ values, copied)
+       * @param loop_closures loop closures confirmed by this frame are appended here
+       */
+      bool addFrame( const uint8_t * feature_vector, std::vector<tLoopClosure> & loop_closures );
+
+      /**
+       * @brief confirms the loop closures of the last 2*(non_max-1) frames, assuming the
+       * sequence ends here (no further frames may be added afterwards)
+       * @return true on success, false otherwise
+       * @param loop_closures loop closures are appended here
+       */
+      bool flush( std::vector<tLoopClosure> & loop_closures );
+
+      /**
+       * @brief number of frames added so far
+       */
+      inline int getNumFrames()
+      {
+        return num_frames_;
+      }
+
+      /**
+       * @brief computes the best score of a segment ending in (i,j) exactly like
+       * cPlaceRecognizer::postProcessSimilarities() (0-1-2-3 step model)
+       * @return score
+       * @param i row of the hypothesis
+       * @param j column of the hypothesis (must be the latest column)
+       * @param value similarity at (i,j)
+       */
+      float segmentScore( int i, int j, float value );
+
+      /**
+       * @brief the second largest segment score of the window centred on (i,j)
+       * @return the threshold, missing scores count as 0
+       * @param first_column column index of dqDpColumns_.front()
+       * @param values buffer for the scores of the window
+       */
+      float windowThreshold( int first_column, int i, int j, std::vector<float> & values );
+
+      /**
+       * @brief confirms the loop closures of one column of dqDpColumns_
+       * @param j the column (all windows reaching it must be complete)
+       * @param loop_closures loop closures are appended here
+       */
+      void suppressNonMaxima( int j, std::vector<tLoopClosure> & loop_closures );
+
+      /**
+       * @brief reads an entry of a stored column
+       * @return value at (i,j), 0 if it does not exist or column j is not stored
+       * @param columns stored columns
+       * @param first_column column index of columns.front()
+       */
+      static float at( const std::deque<tColumn> & columns, int first_column, int i, int j );
+
+    public: /* attributes */
+
+      /**
+       * @brief the batch place recognizer whose parameters, SAD kernel and similarity
+       * function are used (its feature_vectors_ point to vecFeatures_)
+       */
+      cPlaceRecognizer placeRecognizer_;
+
+      /**
+       * @brief dimension of one feature vector
+       */
+      int dim_feature_;
+
+      /**
+       * @brief parameters of the pipeline (see constructor)
+       */
+      int safety_margin_;
+      int segment_length_;
+      int non_max_;
+
+      /**
+       * @brief number of frames added so far
+       */
+      int num_frames_;
+
+      /**
+       * @brief all feature vectors added so far
+       */
+      std::vector<uint8_t> vecFeatures_;
+
+      /**
+       * @brief the last segment_length_ columns of the similarity matrix
+       */
+      std::deque<tColumn> dqSimilarityColumns_;
+
+      /**
+       * @brief the last 4*non_max_-3 columns of segment scores (the dynamic programming matrix),
+       * the windows of all scores within non_max_-1 places of a confirmed column
+       */
+      std::deque<tColumn> dqDpColumns_;
+
+      /**
+       * @brief distances of the newest frame to all older frames (reused between frames)
+       */
+      std::vector<long> vecDistances_;
+
+      /**
+       * @brief dense buffers of segmentScore(), segment_length_ x (3*segment_length_+1)
+       */
+      std::vector<float> vecSimilarityBand_;
+      std::vector<float> vecDpBand_;
+
+      /**
+       * @brief latency of addFrame() in seconds: last frame, maximum and sum over all frames
+       */
+      double latencyLast_;
+      double latencyMax_;
+      double latencySum_;
+
+  };
+}
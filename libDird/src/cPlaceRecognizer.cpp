@@ -24,12 +24,13 @@ Street, Fifth Floor, Boston, MA 02110-1301, USA
 #include "cPlaceRecognizer.h"
 #include <iostream>
 #include <vector>
-#include <set>
 #include <math.h>
 #include <string.h>
 #include <fstream>
 
+#ifdef _OPENMP
 #include <omp.h>
+#endif
 #include <algorithm>
 
 using namespace std;
@@ -42,9 +43,22 @@ namespace DIRD
     matSimilarity_(num_features), 
     matDynamicProgramming_(num_features), 
     matLoopClosures_(num_features), 
-    dim_feature_(dim_feature)
+    dim_feature_(dim_feature),
+    similarityEngine_(SIMILARITY_EARLY_EXIT),
+    segmentEngine_(SEGMENT_BANDED),
+    numThreads_(0),
+    annPruningFactor_(1.0f),
+    pVpTree_(NULL),
+    numAnnDistances_(0)
   {
+    setInstructionSet( cSadKernel::detect() );
 
+    // parameters of logistic function (sigmoid)
+    double factor = 4.0/7.0;  // lower number = sharper cut off, higher number = smoother cut off
+    float sig_max = 7e4f;
+    sigPar1_ = sig_max / 1.85f;
+    sigPar2_ = sig_max / 10.0f * (float)factor;
+    tau1_ = 0.05f;
   }
 
   cPlaceRecognizer::~cPlaceRecognizer()
@@ -52,62 +66,473 @@ namespace DIRD
 
   }
 
+  void cPlaceRecognizer::setInstructionSet( cSadKernel::eInstructionSet instruction_set )
+  {
+    instructionSet_ = std::min( instruction_set, cSadKernel::detect() );
+    pSadKernel_ = cSadKernel::get( instructionSet_, dim_feature_ );
+    pSadTileKernel_ = cSadKernel::getTile( instructionSet_, dim_feature_ );
+  }
+
+  // L1 distance of two per-frame summaries (see initSummaries())
+  template <int NUM_GROUPS>
+  static inline long summaryDistance( const int * summary1, const int * summary2 )
+  {
+    int sum = 0;
+    for (int g = 0; g < NUM_GROUPS; ++g)
+    {
+      sum += abs( summary1[g] - summary2[g] );
+    }
+    return sum;
+  }
+
+  // draws a progress bar for the first i of num rows
+  static void printProgress( int i, int num )
+  {
+    cout << "\r[";
+    for (int j = 0; j <  i/200; ++j)
+    {
+      cout << "#";
+    }
+    for (int j = i/200; j < num/200; ++j)
+    {
+      cout << " ";
+    }
+    cout << "] " << i << " of " << num;
+    cout.flush();
+  }
+
+  int cPlaceRecognizer::getNumThreads()
+  {
+#ifdef _OPENMP
+    return numThreads_ > 0 ? numThreads_ : omp_get_max_threads();
+#else
+    return 1;
+#endif
+  }
+
+  // Splits the rows of the (upper triangular) similarity matrix into num_chunks
+  // consecutive chunks which contain about the same number of pairs. Chunk 
+  // boundaries are multiples of block_size. Returns the num_chunks+1 boundaries.
+  static vector<int> splitRows( int num_features, int safety_margin, int num_chunks, int block_size )
+  {
+    double num_pairs = 0;
+    for (int i = 0; i < num_features; ++i)
+    {
+      num_pairs += max( 0, num_features - i - safety_margin );
+    }
+
+    vector<int> boundaries( 1, 0 );
+    double pairs = 0;
+    for (int i = 0; i < num_features; i += block_size)
+    {
+      for (int r = i; r < min( i + block_size, num_features ); ++r)
+      {
+        pairs += max( 0, num_features - r - safety_margin );
+      }
+      if (pairs >= num_pairs / num_chunks * boundaries.size())
+      {
+        boundaries.push_back( min( i + block_size, num_features ) );
+      }
+    }
+    if (boundaries.back() != num_features)
+    {
+      boundaries.push_back( num_features );
+    }
+    return boundaries;
+  }
+
   bool cPlaceRecognizer::computePairwiseSimilarity( int safety_margin )
   {
 
     matSimilarity_.clear();
 
-    // parameters of logistic function (sigmoid)
-    double factor = 4.0/7.0;  // lower number = sharper cut off, higher number = smoother cut off
-    float sig_max = 7e4f;
-    float sig_par_1 = sig_max / 1.85f;
-    float sig_par_2 = sig_max / 10.0f * (float)factor;
-    float tau_1 = 0.05f;
+    int num_threads = getNumThreads();
+    cout << "Computing vector distance for features (" << cSadKernel::name( instructionSet_ ) 
+      << ", " << num_threads << " threads): " << "\n";
+
+    // The triangular domain is split into chunks of rows with the same amount of 
+    // work, some more chunks than threads for load balancing. Every chunk
+    // collects its hits separately and all of them are merged in the end.
+    vector<int> chunks = splitRows( num_features_, safety_margin, 8 * num_threads, rowBlockSize_ );
+    int num_chunks = (int)chunks.size() - 1;
+    vector< vector<tSimilarityHit> > chunk_hits( num_chunks );
+    int max_depth = (dim_feature_ + earlyExitChunk_ - 1) / earlyExitChunk_;
+    vector< vector<long> > chunk_rejected( num_chunks, vector<long>( max_depth + 1, 0 ) );
+    initSimilarityLut();
+    if (similarityEngine_ == SIMILARITY_CASCADE)
+    {
+      initSummaries();
+    }
+    numAnnDistances_ = 0;
+    if (similarityEngine_ == SIMILARITY_ANN)
+    {
+      pVpTree_ = new cVpTree( feature_vectors_, num_features_, dim_feature_, pSadKernel_ );
+      pVpTree_->build();
+    }
+    int rows_done = 0;
+    int num_failed = 0;
 
-    cout << "Computing vector distance for features: " << "\n";
+    printProgress( 0, num_features_ );
 
-    // loop over all pairs of poses
-    for (int i = 0; i < num_features_; ++i)
+#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads)
+    for (int c = 0; c < num_chunks; ++c)
+    {
+      // loop over all pairs of poses, one block of rows after another
+      for (int i = chunks[c]; i < chunks[c+1]; i += rowBlockSize_)
+      {
+        int i_end = min( i + rowBlockSize_, chunks[c+1] );
+        if (!computeSimilarityRows( i, i_end, safety_margin, chunk_hits[c], chunk_rejected[c] ))
+        {
+#pragma omp atomic
+          num_failed++;
+        }
+
+        // progress bar (shared by all threads)
+#pragma omp critical(dird_progress)
+        {
+          int rows_before = rows_done;
+          rows_done += i_end - i;
+          if ( rows_before / 200 != rows_done / 200 )
+          {
+            printProgress( rows_done, num_features_ );
+          }
+        }
+      }
+    }
+
+    delete pVpTree_;
+    pVpTree_ = NULL;
+
+    if (num_failed > 0)
+    {
+      return false;
+    }
+
+    // hits are sorted by (i,j) within and across chunks, hence the rows are
+    // filled without reordering
+    for (int c = 0; c < num_chunks; ++c)
+    {
+      for (size_t h = 0; h < chunk_hits[c].size(); ++h)
+      {
+        matSimilarity_.add( chunk_hits[c][h].i, chunk_hits[c][h].j, chunk_hits[c][h].similarity );
+      }
+      vector<tSimilarityHit>().swap( chunk_hits[c] );
+    }
+    matSimilarity_.freeze();
+
+    cout << "\n";
+
+    // report how early pairs were rejected
+    vecRejectedAtDepth_.assign( max_depth + 1, 0 );
+    long num_rejected = 0;
+    for (int c = 0; c < num_chunks; ++c)
+    {
+      for (int d = 0; d <= max_depth; ++d)
+      {
+        vecRejectedAtDepth_[d] += chunk_rejected[c][d];
+        num_rejected += chunk_rejected[c][d];
+      }
+    }
+    if (similarityEngine_ == SIMILARITY_EARLY_EXIT || similarityEngine_ == SIMILARITY_CASCADE)
+    {
+      cout << "Rejected " << num_rejected << " pairs beyond distance " << maxDistance_ << ", after computing\n";
+      if (similarityEngine_ == SIMILARITY_CASCADE)
+      {
+        cout << "  lower bounds only: " << vecRejectedAtDepth_[0] << " pairs\n";
+      }
+      for (int d = 1; d <= max_depth; ++d)
+      {
+        cout << "  " << min( d * earlyExitChunk_, dim_feature_ ) << " of " << dim_feature_ 
+          << " dimensions: " << vecRejectedAtDepth_[d] << " pairs\n";
+      }
+    }
+    if (similarityEngine_ == SIMILARITY_ANN)
+    {
+      cout << "Computed " << numAnnDistances_ << " distances (pruning factor " << annPruningFactor_ << ")\n";
+    }
+
+    return true;
+  }
+
+  bool cPlaceRecognizer::computeSimilarityRows( int row_begin, int row_end, int safety_margin, vector<tSimilarityHit> & hits, vector<long> & rejected )
+  {
+    if (similarityEngine_ == SIMILARITY_BRUTE_FORCE)
     {
+      for (int i = row_begin; i < row_end; ++i)
+      {
+        // skip poses very near by (safety_margin)
+        for (int j = i + safety_margin; j < num_features_; ++j)
+        {
+          // compute vector distance ...
+          long distance = dist(i,j);
+          // ... and translate it into a similarity score (0 ... 1) by a logistic function (sigmoid)
+          float sim = similarity( distance );
+          // dont polute similarity matrix and
+          // store only those values which seem somewhat promising. 
+          if (sim > tau1_) // tau_1 is a very conservative threshold
+          {
+            tSimilarityHit hit = { i, j, sim };
+            hits.push_back( hit );
+          }
+        }
+      }
+      return true;
+    }
 
-      // progress bar
-      if ( i % 200 == 0)
+    if (similarityEngine_ == SIMILARITY_CASCADE)
+    {
+      for (int i = row_begin; i < row_end; ++i)
+      {
+        const int * coarse_i = &vecCoarseSummaries_[ i * numCoarseGroups_ ];
+        const int * fine_i = &vecFineSummaries_[ i * numFineGroups_ ];
+        for (int j = i + safety_margin; j < num_features_; ++j)
+        {
+          // coarse-to-fine lower bounds of the distance, the feature vectors
+          // themselves are only touched if both of them are below the cut off
+          if (summaryDistance<numCoarseGroups_>( coarse_i, &vecCoarseSummaries_[ j * numCoarseGroups_ ] ) > maxDistance_ ||
+              summaryDistance<numFineGroups_>( fine_i, &vecFineSummaries_[ j * numFineGroups_ ] ) > maxDistance_)
+          {
+            rejected[0]++;
+            continue;
+          }
+
+          int depth;
+          long distance = distBounded( i, j, maxDistance_, depth );
+          if (distance > maxDistance_)
+          {
+            rejected[ depth ]++;
+            continue;
+          }
+          tSimilarityHit hit = { i, j, vecSimilarityLut_[ distance ] };
+          hits.push_back( hit );
+        }
+      }
+      return true;
+    }
+
+    if (similarityEngine_ == SIMILARITY_ANN)
+    {
+      vector<cVpTree::tNeighbour> neighbours;
+      long num_distances = 0;
+      for (int i = row_begin; i < row_end; ++i)
       {
-        cout << "\r[";
-        for (int j = 0; j <  i/200; ++j)
+        // all frames within maxDistance_, of which those closer than safety_margin 
+        // are dropped. The neighbours are sorted to keep the hits sorted by (i,j).
+        neighbours.clear();
+        num_distances += pVpTree_->findWithinRadius( i, maxDistance_, annPruningFactor_, neighbours );
+        vector< pair<int,long> > row;
+        for (size_t n = 0; n < neighbours.size(); ++n)
         {
-          cout << "#";
+          if (neighbours[n].index >= i + safety_margin)
+          {
+            row.push_back( make_pair( neighbours[n].index, neighbours[n].distance ) );
+          }
         }
-        for (int j = i/200; j < num_features_/200; ++j)
+        sort( row.begin(), row.end() );
+        for (size_t n = 0; n < row.size(); ++n)
         {
-          cout << " ";
+          tSimilarityHit hit = { i, row[n].first, vecSimilarityLut_[ row[n].second ] };
+          hits.push_back( hit );
         }
-        cout << "] " << i << " of " << num_features_;
-        cout.flush();
       }
+#pragma omp atomic
+      numAnnDistances_ += num_distances;
+      return true;
+    }
 
+    // SIMILARITY_TILED: The rows of the block are matched against blocks of
+    // colBlockSize_ columns (both stay in the L2 cache). Within such a block
+    // micro-tiles of tileSize_ x tileSize_ distances are computed at once such that
+    // every loaded chunk of a feature vector is used tileSize_ times.
+    // SIMILARITY_EARLY_EXIT additionally stops computing a micro-tile as soon as
+    // all its partial distances exceed maxDistance_ (see initSimilarityLut()).
+    static const int T = cSadKernel::tileSize_;
+    bool early_exit = (similarityEngine_ == SIMILARITY_EARLY_EXIT);
+    vector< vector<tSimilarityHit> > row_hits( row_end - row_begin );
+    long distances[ T * T ];
+    long partial_distances[ T * T ];
+    int depths[ T * T ];
 
-      // skip poses very near by (safety_margin)
-      for (int j = i + safety_margin; j < num_features_; ++j)
+    for (int j_begin = row_begin + safety_margin; j_begin < num_features_; j_begin += colBlockSize_)
+    {
+      int j_end = min( j_begin + colBlockSize_, num_features_ );
+
+      for (int i = row_begin; i < row_end; i += T)
       {
-        // compute vector distance ...
-        long distance = dist(i,j);
-        // ... and translate it into a similarity score (0 ... 1) by a logistic function (sigmoid)
-        float similarity = 1.0f - 1.0f/( 1.0f + exp( -( ((float)distance) - sig_par_1)/sig_par_2 ) );
-        // dont polute similarity matrix and
-        // store only those values which seem somewhat promising. 
-        if (similarity > tau_1) // tau_1 is a very conservative threshold
+        // the whole tile row is closer than safety_margin
+        if (i + safety_margin >= j_end)
         {
-          matSimilarity_(i,j) = similarity;
+          break;
+        }
+
+        for (int j = j_begin; j < j_end; j += T)
+        {
+          // skip tiles which are entirely closer than safety_margin
+          if (j + T - 1 < i + safety_margin)
+          {
+            continue;
+          }
+
+          int num_i = min( T, row_end - i );
+          int num_j = min( T, j_end - j );
+          if (num_i == T && num_j == T && !early_exit)
+          {
+            pSadTileKernel_( &feature_vectors_[ (size_t)i * dim_feature_ ], &feature_vectors_[ (size_t)j * dim_feature_ ], 
+                dim_feature_, dim_feature_, distances );
+          }
+          else if (num_i == T && num_j == T)
+          {
+            // accumulate the tile chunk by chunk until every pair is beyond the cut off
+            memset( distances, 0, sizeof(distances) );
+            int depth = 0;
+            for (int k = 0; k < dim_feature_; k += earlyExitChunk_)
+            {
+              int len = dim_feature_ - k < earlyExitChunk_ ? dim_feature_ - k : earlyExitChunk_;
+              pSadTileKernel_( &feature_vectors_[ (size_t)i * dim_feature_ + k ], &feature_vectors_[ (size_t)j * dim_feature_ + k ], 
+                  dim_feature_, len, partial_distances );
+              depth++;
+
+              bool all_rejected = true;
+              for (int r = 0; r < T; ++r)
+              {
+                for (int c = 0; c < T; ++c)
+                {
+                  distances[ r * T + c ] += partial_distances[ r * T + c ];
+                  if (distances[ r * T + c ] <= maxDistance_ && j + c >= i + r + safety_margin)
+                  {
+                    all_rejected = false;
+                  }
+                }
+              }
+              if (all_rejected)
+              {
+                break;
+              }
+            }
+            for (int d = 0; d < T * T; ++d)
+            {
+              depths[d] = depth;
+            }
+          }
+          else
+          {
+            // incomplete tiles at the border of the block
+            for (int r = 0; r < num_i; ++r)
+            {
+              for (int c = 0; c < num_j; ++c)
+              {
+                if (early_exit)
+                {
+                  distances[ r * T + c ] = distBounded( i + r, j + c, maxDistance_, depths[ r * T + c ] );
+                }
+                else
+                {
+                  distances[ r * T + c ] = dist( i + r, j + c );
+                }
+              }
+            }
+          }
+
+          for (int r = 0; r < num_i; ++r)
+          {
+            for (int c = 0; c < num_j; ++c)
+            {
+              // skip poses very near by (safety_margin)
+              if (j + c < i + r + safety_margin)
+              {
+                continue;
+              }
+
+              long distance = distances[ r * T + c ];
+              if (early_exit)
+              {
+                // only distances up to maxDistance_ yield a similarity above tau1_
+                if (distance > maxDistance_)
+                {
+                  rejected[ depths[ r * T + c ] ]++;
+                  continue;
+                }
+                tSimilarityHit hit = { i + r, j + c, vecSimilarityLut_[ distance ] };
+                row_hits[ i + r - row_begin ].push_back( hit );
+                continue;
+              }
+
+              float sim = similarity( distance );
+              if (sim > tau1_)
+              {
+                tSimilarityHit hit = { i + r, j + c, sim };
+                row_hits[ i + r - row_begin ].push_back( hit );
+              }
+            }
+          }
         }
       }
     }
 
-    cout << "\n";
+    // column blocks were processed in ascending order, so every row is sorted already
+    for (size_t r = 0; r < row_hits.size(); ++r)
+    {
+      hits.insert( hits.end(), row_hits[r].begin(), row_hits[r].end() );
+    }
 
     return true;
   }
 
+  void cPlaceRecognizer::initSummaries()
+  {
+    // Sums over consecutive groups of dimensions. By the triangle inequality
+    // |sum(a_g) - sum(b_g)| <= sum(|a_g - b_g|) for every group g, hence the
+    // distance of two summaries is a lower bound of the distance of the feature
+    // vectors. Every coarse group is the union of four fine groups.
+    vecCoarseSummaries_.assign( num_features_ * numCoarseGroups_, 0 );
+    vecFineSummaries_.assign( num_features_ * numFineGroups_, 0 );
+
+#pragma omp parallel for num_threads(getNumThreads())
+    for (int i = 0; i < num_features_; ++i)
+    {
+      const uint8_t * feature = &feature_vectors_[ (size_t)i * dim_feature_ ];
+      for (int g = 0; g < numFineGroups_; ++g)
+      {
+        int sum = 0;
+        for (int k = g * dim_feature_ / numFineGroups_; k < (g + 1) * dim_feature_ / numFineGroups_; ++k)
+        {
+          sum += feature[k];
+        }
+        vecFineSummaries_[ i * numFineGroups_ + g ] = sum;
+        vecCoarseSummaries_[ i * numCoarseGroups_ + g * numCoarseGroups_ / numFineGroups_ ] += sum;
+      }
+    }
+  }
+
+  void cPlaceRecognizer::initSimilarityLut()
+  {
+    // The sigmoid is monotonically decreasing, hence tau1_ corresponds to a
+    // maximal distance. It is computed analytically and refined by evaluating
+    // similarity() itself such that rounding cannot make a difference.
+    double analytic = sigPar1_ + sigPar2_ * log( (1.0 - tau1_) / tau1_ );
+    maxDistance_ = -1;
+    for (long d = max( 0L, (long)analytic - 256 ); d <= (long)analytic + 256; ++d)
+    {
+      if (similarity( d ) > tau1_)
+      {
+        maxDistance_ = d;
+      }
+    }
+
+    // similarities of all distances that pass tau1_
+    vecSimilarityLut_.resize( maxDistance_ + 1 );
+    for (long d = 0; d <= maxDistance_; ++d)
+    {
+      vecSimilarityLut_[d] = similarity( d );
+    }
+  }
+
+  // orders column entries by their row
+  static inline bool lessRow( const cPlaceRecognizer::tColumnEntry & entry1, const cPlaceRecognizer::tColumnEntry & entry2 )
+  {
+    return entry1.i < entry2.i;
+  }
+
   bool cPlaceRecognizer::postProcessSimilarities( int segment_length )
   {
 
@@ -116,95 +541,390 @@ namespace DIRD
     float tau_3 = 0.05f;
     float tau_2 = tau_3;
 
-    // we use a 0-1-2-3 model
-    vector<int> steps;
-    for (int i = 0; i <= 3; ++i)
+    if (segmentEngine_ == SEGMENT_SWEEP)
+    {
+      sweepSegments( segment_length, tau_2, tau_3, matDynamicProgramming_ );
+      return true;
+    }
+
+    // the hypotheses sorted by (i,j)
+    vector<tSimilarityHit> hypotheses;
+    for (int i = 0; i < num_features_; ++i)
     {
-      steps.push_back(i);
+      for (const tSparseMatrix::tEntry * entry = matSimilarity_.rowBegin(i); entry != matSimilarity_.rowEnd(i); ++entry)
+      {
+        // skip unpromissing pairs
+        if (entry->value < tau_2)
+        {
+          continue;
+        }
+
+        tSimilarityHit hypothesis = { i, entry->j, entry->value };
+        hypotheses.push_back( hypothesis );
+      }
     }
 
-    // start dynamic programming sweep
-    set<int> startIndicies;
-    tSparseMatrix DP(num_features_);
-    int numHypos = matSimilarity_.size();
+    // The hypotheses are independent of each other (they only read matSimilarity_),
+    // each thread scores chunks of them with its own dense buffers
+    int num_threads = getNumThreads();
+    int numHypos = (int)hypotheses.size();
+    vector<float> scores( numHypos );
     int counter = 0;
+    static const int chunk_size = 256;
 
-    // loop overe all (non-zero) entries of the similarity matrix
-    for (tSparseMatrixIterator iter = matSimilarity_.begin(); 
-        iter != matSimilarity_.end(); 
-        iter++)
+#pragma omp parallel num_threads(num_threads)
     {
+      vector<float> similarity_band;
+      vector<float> dp_band;
 
-      if ( counter++ % 1000 == 0 )
+#pragma omp for schedule(dynamic,1)
+      for (int c = 0; c < (numHypos + chunk_size - 1) / chunk_size; ++c)
       {
-        cout << "\rProcessing loop closure  hypothesis " << counter << " of " << numHypos;
-        cout.flush();
+        int h_end = min( (c + 1) * chunk_size, numHypos );
+        for (int h = c * chunk_size; h < h_end; ++h)
+        {
+          scores[h] = segmentScore( hypotheses[h].i, hypotheses[h].j, hypotheses[h].similarity, segment_length, 
+              similarity_band, dp_band );
+        }
+
+        // progress (shared by all threads)
+#pragma omp critical(dird_progress)
+        {
+          int counter_before = counter;
+          counter += h_end - c * chunk_size;
+          if ( counter_before / 4096 != counter / 4096 || counter == numHypos )
+          {
+            cout << "\rProcessing loop closure  hypothesis " << counter << " of " << numHypos;
+            cout.flush();
+          }
+        }
       }
+    }
 
-      // skip unpromissing pairs
-      if (iter->second < tau_2)
+    // store the values in the loop closure matrix
+    for (int h = 0; h < numHypos; ++h)
+    {
+      if ( scores[h] > tau_3 * segment_length )
       {
-        continue;
+        matDynamicProgramming_.add( hypotheses[h].i, hypotheses[h].j, scores[h] );
       }
+    }
+    matDynamicProgramming_.freeze();
 
-      // compute 2d index
-      int j = iter->first % num_features_;
-      int i = (iter->first - j) / num_features_;
-
-      startIndicies.clear();
-      startIndicies.insert(i);
+    cout << "" << "\n";
 
-      DP.clear();
-      DP(i,j) = iter->second;
+    if (segmentEngine_ == SEGMENT_VALIDATE)
+    {
+      tSparseMatrix sweep( num_features_ );
+      sweepSegments( segment_length, tau_2, tau_3, sweep );
 
-      float maxValue = 0;
-      for ( int jDP = j; jDP > j-segment_length+1; jDP-- )
+      // scores of both engines and those above the threshold of one engine only
+      int num_common = 0;
+      int num_banded_only = 0;
+      float max_difference = 0;
+      for (int i = 0; i < num_features_; ++i)
       {
-        if (jDP < 1)
+        for (const tSparseMatrix::tEntry * entry = matDynamicProgramming_.rowBegin(i); 
+            entry != matDynamicProgramming_.rowEnd(i); ++entry)
         {
-          break;
+          const tSparseMatrix::tEntry * entry_sweep = sweep.lowerBound( i, entry->j );
+          if (entry_sweep == sweep.rowEnd(i) || entry_sweep->j != entry->j)
+          {
+            num_banded_only++;
+            continue;
+          }
+          num_common++;
+          max_difference = max( max_difference, (float)fabs( entry_sweep->value - entry->value ) );
         }
+      }
+      int num_sweep_only = (int)sweep.size() - num_common;
+
+      cout << "Validation of the sweep: " << num_common << " common segment scores (largest difference " 
+        << max_difference << "), " << num_banded_only << " banded only, " << num_sweep_only << " sweep only\n";
+    }
+
+    return true;
+  }
 
-        set<int> startIndiciesCopy = startIndicies;
-        for ( set<int>::iterator iterIdx = startIndiciesCopy.begin(); 
-            iterIdx != startIndiciesCopy.end(); 
-            iterIdx++)
+  void cPlaceRecognizer::sweepSegments( int segment_length, float tau_2, float tau_3, tSparseMatrix & result )
+  {
+    // the similarity matrix by columns, sorted by row as the rows are visited in order
+    vector< vector<tColumnEntry> > columns( num_features_ );
+    for (int i = 0; i < num_features_; ++i)
+    {
+      for (const tSparseMatrix::tEntry * entry = matSimilarity_.rowBegin(i); entry != matSimilarity_.rowEnd(i); ++entry)
+      {
+        tColumnEntry column_entry = { i, entry->value };
+        columns[ entry->j ].push_back( column_entry );
+      }
+    }
+
+    // best paths of k = 0 ... segment_length-1 steps ending in the previous and the
+    // current column (sorted by row, only cells reached by non-zero similarities)
+    vector< vector<tColumnEntry> > previous( segment_length );
+    vector< vector<tColumnEntry> > current( segment_length );
+
+    // best path of the previous column leading to each row, and the rows set
+    vector<float> best( num_features_, 0.0f );
+    vector<int> rows;
+
+    for (int j = 0; j < num_features_; ++j)
+    {
+      vector<tColumnEntry> & column = columns[j];
+      current[0] = column;
+
+      // paths reach back to column 0 at most
+      int num_steps = min( segment_length - 1, j );
+      for (int k = 1; k <= num_steps; ++k)
+      {
+        // the cells reached from the previous column, in increasing order as 
+        // the previous column is sorted
+        const vector<tColumnEntry> & source = previous[k-1];
+        rows.clear();
+        for (size_t e = 0; e < source.size(); ++e)
         {
-          long idx = *iterIdx;
-          for ( vector<int>::iterator iterS = steps.begin(); 
-              iterS != steps.end(); 
-              iterS++ )
+          for (int s = 0; s <= 3 && source[e].i + s < num_features_; ++s)
           {
-            int s = *iterS;
-            if (idx-s < 0)
+            int r = source[e].i + s;
+            if (best[r] == 0)
             {
-              break;
+              rows.push_back( r );
             }
+            best[r] = max( best[r], source[e].value );
+          }
+        }
 
-            startIndicies.insert(idx-s);
+        // plus the similarities of the current column
+        vector<tColumnEntry> & dest = current[k];
+        dest.clear();
+        size_t c = 0;
+        for (size_t r = 0; r < rows.size() || c < column.size(); )
+        {
+          tColumnEntry entry;
+          if (c == column.size() || (r < rows.size() && rows[r] < column[c].i))
+          {
+            entry.i = rows[r++];
+            entry.value = best[ entry.i ];
+          }
+          else
+          {
+            entry.i = column[c].i;
+            entry.value = best[ entry.i ] + column[c].value;
+            r += r < rows.size() && rows[r] == column[c].i;
+            c++;
+          }
+          dest.push_back( entry );
+        }
 
-            // safely access elements
-            float dp_source = DP.at( idx, jDP );
-            float dp_dest = DP.at( idx-s, jDP-1 );
-            float arr_dest = matSimilarity_.at( idx-s, jDP-1 );
+        for (size_t r = 0; r < rows.size(); ++r)
+        {
+          best[ rows[r] ] = 0;
+        }
+      }
 
-            DP(idx-s, jDP-1) = max( dp_dest, dp_source + arr_dest );
-            maxValue = max( DP(idx-s, jDP-1), maxValue);
+      // the hypotheses of the column (the path of exactly num_steps steps is the 
+      // best one as similarities are positive)
+      if (num_steps > 0)
+      {
+        const vector<tColumnEntry> & paths = current[ num_steps ];
+        vector<tColumnEntry>::const_iterator path = paths.begin();
+        for (size_t e = 0; e < column.size(); ++e)
+        {
+          if (column[e].value < tau_2)
+          {
+            continue;
+          }
+          path = lower_bound( path, paths.end(), column[e], lessRow );
+          if (path->value > tau_3 * segment_length)
+          {
+            result.add( column[e].i, j, path->value );
           }
         }
       }
 
-      // store value in loop closure matrix
-      if ( maxValue > tau_3 * segment_length )
+      previous.swap( current );
+    }
+    result.freeze();
+  }
+
+  float cPlaceRecognizer::segmentScore( int i, int j, float value, int segment_length, 
+      vector<float> & similarity_band, vector<float> & dp_band )
+  {
+    // the similarities of the band (see dynamicProgrammingBand()), only the cells
+    // reachable from (i,j) are read
+    int width = 3 * segment_length + 1;
+    int row_begin = i - 3 * segment_length;
+    int num_steps = min( segment_length - 1, j );
+
+    similarity_band.resize( segment_length * width );
+    dp_band.assign( segment_length * width, 0.0f );
+    for (int t = 1; t <= num_steps; ++t)
+    {
+      int row_first = max( 0, i - 3 * t );
+      fill( &similarity_band[ t * width + row_first - row_begin ], &similarity_band[ t * width + i - row_begin ] + 1, 0.0f );
+    }
+
+    // the columns j-num_steps ... j-1 of each row, cells of column j-t are 
+    // reachable from row i-3t on
+    for (int row = max( 0, i - 3 * num_steps ); row <= i; ++row)
+    {
+      const tSparseMatrix::tEntry * row_end = matSimilarity_.rowEnd( row );
+      for (const tSparseMatrix::tEntry * entry = matSimilarity_.lowerBound( row, j - num_steps ); 
+          entry != row_end && entry->j < j; ++entry)
       {
-        matDynamicProgramming_(i,j) = maxValue;
+        int t = j - entry->j;
+        if (row >= i - 3 * t)
+        {
+          similarity_band[ t * width + row - row_begin ] = entry->value;
+        }
       }
+    }
+
+    return dynamicProgrammingBand( &similarity_band[0], &dp_band[0], i, segment_length, num_steps, value );
+  }
 
+  float cPlaceRecognizer::dynamicProgrammingBand( const float * similarity_band, float * dp_band, int i, 
+      int segment_length, int num_steps, float value )
+  {
+    // after t steps exactly the rows max(0,i-3t) ... i are reached
+    int width = 3 * segment_length + 1;
+    int row_begin = i - 3 * segment_length;
+
+    dp_band[ i - row_begin ] = value;
+    float maxValue = 0;
+    for (int t = 0; t < num_steps; ++t)
+    {
+      const float * dp_source = &dp_band[ t * width ];
+      float * dp_dest = &dp_band[ (t + 1) * width ];
+      const float * arr_dest = &similarity_band[ (t + 1) * width ];
+      for (int idx = max( 0, i - 3 * t ); idx <= i; ++idx)
+      {
+        for (int s = 0; s <= 3; ++s)
+        {
+          if (idx - s < 0)
+          {
+            break;
+          }
+          int r = idx - s - row_begin;
+          dp_dest[r] = max( dp_dest[r], dp_source[ idx - row_begin ] + arr_dest[r] );
+          maxValue = max( dp_dest[r], maxValue );
+        }
+      }
     }
 
-    cout << "" << "\n";
+    return maxValue;
+  }
 
-    return true;
+  // orders row entries by their column
+  static inline bool lessColumn( const cPlaceRecognizer::tSparseMatrix::tEntry & entry1, 
+      const cPlaceRecognizer::tSparseMatrix::tEntry & entry2 )
+  {
+    return entry1.j < entry2.j;
+  }
+
+  void cPlaceRecognizer::tSparseMatrix::clear()
+  {
+    vector<tEntry>().swap( vecEntries_ );
+    vecRowOffsets_.assign( size_ + 1, 0 );
+    vector<tTriplet>().swap( vecTriplets_ );
+  }
+
+  void cPlaceRecognizer::tSparseMatrix::freeze()
+  {
+    // the frozen entries come first, so that added ones replace them
+    vector<tTriplet> triplets;
+    triplets.reserve( vecEntries_.size() + vecTriplets_.size() );
+    for (int i = 0; i < size_; ++i)
+    {
+      for (const tEntry * entry = rowBegin(i); entry != rowEnd(i); ++entry)
+      {
+        tTriplet triplet = { i, entry->j, entry->value };
+        triplets.push_back( triplet );
+      }
+    }
+    triplets.insert( triplets.end(), vecTriplets_.begin(), vecTriplets_.end() );
+    vector<tTriplet>().swap( vecTriplets_ );
+
+    // counting sort by row (keeps the order within a row)
+    vecRowOffsets_.assign( size_ + 1, 0 );
+    for (size_t t = 0; t < triplets.size(); ++t)
+    {
+      vecRowOffsets_[ triplets[t].i + 1 ]++;
+    }
+    for (int i = 0; i < size_; ++i)
+    {
+      vecRowOffsets_[i+1] += vecRowOffsets_[i];
+    }
+    vector<int> next( vecRowOffsets_.begin(), vecRowOffsets_.end() - 1 );
+    vector<tEntry> entries( triplets.size() );
+    for (size_t t = 0; t < triplets.size(); ++t)
+    {
+      tEntry entry = { triplets[t].j, triplets[t].value };
+      entries[ next[ triplets[t].i ]++ ] = entry;
+    }
+    vector<tTriplet>().swap( triplets );
+
+    // sort the rows by column and keep the last of duplicate entries
+    int num_entries = 0;
+    int row_begin = 0;
+    for (int i = 0; i < size_; ++i)
+    {
+      int row_end = vecRowOffsets_[i+1];
+      if (!is_sorted( entries.begin() + row_begin, entries.begin() + row_end, lessColumn ))
+      {
+        stable_sort( entries.begin() + row_begin, entries.begin() + row_end, lessColumn );
+      }
+
+      vecRowOffsets_[i] = num_entries;
+      for (int e = row_begin; e < row_end; ++e)
+      {
+        if (num_entries > vecRowOffsets_[i] && entries[ num_entries - 1 ].j == entries[e].j)
+        {
+          entries[ num_entries - 1 ] = entries[e];
+        }
+        else
+        {
+          entries[ num_entries++ ] = entries[e];
+        }
+      }
+      row_begin = row_end;
+    }
+    vecRowOffsets_[ size_ ] = num_entries;
+    entries.resize( num_entries );
+    vecEntries_.swap( entries );
+  }
+
+  const cPlaceRecognizer::tSparseMatrix::tEntry * cPlaceRecognizer::tSparseMatrix::lowerBound( int i, int j ) const
+  {
+    tEntry key = { j, 0.0f };
+    return lower_bound( rowBegin(i), rowEnd(i), key, lessColumn );
+  }
+
+  void cPlaceRecognizer::tSparseMatrix::getAntiDiagonals( vector<int> & diagonal_offsets, vector<int> & entries ) const
+  {
+    diagonal_offsets.assign( 2 * size_, 0 );
+    for (int i = 0; i < size_; ++i)
+    {
+      for (const tEntry * entry = rowBegin(i); entry != rowEnd(i); ++entry)
+      {
+        diagonal_offsets[ i + entry->j + 1 ]++;
+      }
+    }
+    for (int d = 1; d < 2 * size_; ++d)
+    {
+      diagonal_offsets[d] += diagonal_offsets[d-1];
+    }
+
+    // the rows are visited in increasing order
+    vector<int> next( diagonal_offsets );
+    entries.resize( size() );
+    for (int i = 0; i < size_; ++i)
+    {
+      for (int e = vecRowOffsets_[i]; e < vecRowOffsets_[i+1]; ++e)
+      {
+        entries[ next[ i + vecEntries_[e].j ]++ ] = e;
+      }
+    }
   }
 
   bool cPlaceRecognizer::tSparseMatrix::toImage( uint8_t * img, int img_size )
@@ -216,26 +936,21 @@ namespace DIRD
 
     // compute max value of matrix
     float max_value = 0;
-    for (iterator iter = this->begin(); 
-        iter != this->end(); 
-        iter++)
+    for (size_t e = 0; e < vecEntries_.size(); ++e)
     {
-      max_value = max(max_value, iter->second);
+      max_value = max(max_value, vecEntries_[e].value);
     }
 
     // loop over all non-zero matrix entries and fill image
-    for (iterator iter = this->begin(); 
-        iter != this->end(); 
-        iter++)
+    for (int i = 0; i < size_; ++i)
     {
-      // compute 2d index
-      int j = iter->first % size_;
-      int i = (iter->first - j) / size_;
-
       int ii = (int)((float)i * scale);
-      int jj = (int)((float)j * scale);
+      for (const tEntry * entry = rowBegin(i); entry != rowEnd(i); ++entry)
+      {
+        int jj = (int)((float)entry->j * scale);
 
-      img[ ii * img_size + jj] = (uint8_t)max(iter->second / max_value * 255, (float)img[ii * img_size + j]);
+        img[ ii * img_size + jj] = (uint8_t)max(entry->value / max_value * 255, (float)img[ii * img_size + jj]);
+      }
     }
 
     return true;
@@ -255,17 +970,14 @@ namespace DIRD
 
     matrix_file << size_ << "\n";
 
-    // loop over all non-zero matrix entries and fill image
-    for (iterator iter = this->begin(); 
-        iter != this->end(); 
-        iter++)
+    // loop over all non-zero matrix entries row by row
+    for (int i = 0; i < size_; ++i)
     {
-      // compute 2d index
-      int j = iter->first % size_;
-      int i = (iter->first - j) / size_;
-
-      // dump to file
-      matrix_file << i << " " << j << " " << iter->second << "\n";
+      for (const tEntry * entry = rowBegin(i); entry != rowEnd(i); ++entry)
+      {
+        // dump to file
+        matrix_file << i << " " << entry->j << " " << entry->value << "\n";
+      }
     }
 
     matrix_file.close();
@@ -273,42 +985,127 @@ namespace DIRD
     return true;
   }
 
+  // the two largest values of a window (missing cells count as 0)
+  struct tTop2
+  {
+    float first;
+    float second;
+  };
+
+  static inline tTop2 mergeTop2( const tTop2 & a, const tTop2 & b )
+  {
+    tTop2 top;
+    if (a.first >= b.first)
+    {
+      top.first = a.first;
+      top.second = max( a.second, b.first );
+    }
+    else
+    {
+      top.first = b.first;
+      top.second = max( b.second, a.first );
+    }
+    return top;
+  }
+
+  // computes the two largest values of the window |j - j_k| < non_max around each
+  // of the entries [begin,end) of one anti-diagonal (ordered by j). The windows 
+  // slide in one direction, the values in a window are kept in a queue of two 
+  // stacks with running top 2: values are pushed onto back, front holds the 
+  // top 2 of each of its values and all values pushed after it. Hence every 
+  // value is moved once, linear time.
+  static void windowTop2( const vector<cPlaceRecognizer::tSimilarityHit> & entries, const vector<float> & values, 
+      int begin, int end, int non_max, vector<tTop2> & top, vector<float> & back, vector<tTop2> & front )
+  {
+    static const tTop2 empty = { 0.0f, 0.0f };
+    back.clear();
+    front.clear();
+    tTop2 back_top = empty;
+    int window_begin = begin;
+    int window_end = begin;
+    for (int k = begin; k < end; ++k)
+    {
+      while (window_end < end && abs( entries[window_end].j - entries[k].j ) < non_max)
+      {
+        tTop2 value = { values[window_end++], 0.0f };
+        back.push_back( value.first );
+        back_top = mergeTop2( back_top, value );
+      }
+      while (abs( entries[window_begin].j - entries[k].j ) >= non_max)
+      {
+        if (front.empty())
+        {
+          for (size_t m = back.size(); m-- > 0; )
+          {
+            tTop2 value = { back[m], 0.0f };
+            front.push_back( mergeTop2( value, front.empty() ? empty : front.back() ) );
+          }
+          back.clear();
+          back_top = empty;
+        }
+        front.pop_back();
+        window_begin++;
+      }
+      top[k] = mergeTop2( front.empty() ? empty : front.back(), back_top );
+    }
+  }
+
   bool cPlaceRecognizer::computeLoops( int non_max )
   {
 
     matLoopClosures_ = matDynamicProgramming_;
 
-    for (tSparseMatrixIterator iter = matLoopClosures_.begin(); 
-        iter != matLoopClosures_.end(); 
-        iter++)
+    // a window of a single entry suppresses nothing
+    if (non_max < 2)
     {
+      return true;
+    }
 
-      // compute 2d index
-      int j = iter->first % num_features_;
-      int i = (iter->first - j) / num_features_;
+    // the entries along their anti-diagonals
+    vector<int> diagonal_offsets, indices;
+    matLoopClosures_.getAntiDiagonals( diagonal_offsets, indices );
+    int num_entries = (int)indices.size();
+    vector<tSimilarityHit> entries( num_entries );
+    vector<float> values( num_entries );
+    for (int d = 0; d + 1 < (int)diagonal_offsets.size(); ++d)
+    {
+      for (int k = diagonal_offsets[d]; k < diagonal_offsets[d+1]; ++k)
+      {
+        const tSparseMatrix::tEntry & entry = matLoopClosures_.vecEntries_[ indices[k] ];
+        tSimilarityHit hit = { d - entry.j, entry.j, entry.value };
+        entries[k] = hit;
+        values[k] = entry.value;
+      }
+    }
+
+    vector<tTop2> top( num_entries );
+    vector<float> thresholds( num_entries );
+    vector<tTop2> max_thresholds( num_entries );
+    vector<float> back;
+    vector<tTop2> front;
 
-      // find maximum
-      vector<float> vecVals;
-      for (int k = -non_max+1; k < non_max; ++k)
+    for (int d = 0; d + 1 < (int)diagonal_offsets.size(); ++d)
+    {
+      int begin = diagonal_offsets[d];
+      int end = diagonal_offsets[d+1];
+
+      // the threshold of the window centred on each entry is its second largest value
+      windowTop2( entries, values, begin, end, non_max, top, back, front );
+      for (int k = begin; k < end; ++k)
       {
-        vecVals.push_back( matLoopClosures_.at(i-k, j+k) );
+        thresholds[k] = top[k].second;
       }
 
-      // keep only the top 2 and discard others
-      sort(vecVals.begin(), vecVals.end());
-      if (vecVals.size() >= 2)
+      // an entry is suppressed if it is below the threshold of any window it lies in,
+      // i.e. of any window centred within non_max-1 places
+      windowTop2( entries, thresholds, begin, end, non_max, max_thresholds, back, front );
+      for (int k = begin; k < end; ++k)
       {
-        float tau = vecVals[ vecVals.size() - 2 ];
-        // surpress non-maximum
-        for (int k = -non_max+1; k < non_max; ++k)
+        if (values[k] < max_thresholds[k].first)
         {
-          if ( matLoopClosures_.at(i-k, j+k) != 0 && matLoopClosures_.at(i-k, j+k) < tau )
-          {
-            matLoopClosures_(i-k,j+k) = 0;
-          }
+          matLoopClosures_.vecEntries_[ indices[k] ].value = 0;
         }
       }
-
     }
 
     return true;
@@ -31,20 +31,20 @@ typedef unsigned char uint8_t;
 #endif
 
 #include <stdlib.h>
+#include <math.h>
 #include <string>
+#include <vector>
 #include <sstream>
 #include <fstream>
 #include <iostream>
-
-#include <map>
-
-// check for the new c++11 standard
-#if defined(__GXX_EXPERIMENTAL_CXX0X__) || __cplusplus >= 201103L
-#include <unordered_map>
-#endif
+#include <algorithm>
+#include <cassert>
 
 #include <emmintrin.h>
 
+#include "cSadKernel.h"
+#include "cVpTree.h"
+
 namespace DIRD
 {
   class cPlaceRecognizer
@@ -52,27 +52,44 @@ namespace DIRD
 
     public: /* public classes/enums/types etc... */
 
-      // check for the new c++11 standard
-#if defined(__GXX_EXPERIMENTAL_CXX0X__) || __cplusplus >= 201103L
-      typedef std::unordered_map<long,float> tMap;
-#else
-      typedef std::map<long,float> tMap;
-#endif
-
       // some homegrown/lightweight sparse matrix type
+      //
+      // Built in two phases: entries are appended to a list of triplets by add()
+      // (cheap, in any order), freeze() sorts them into rows (compressed sparse 
+      // rows). Only frozen entries are visible to the read accessors; rows are
+      // sorted by column, so iterating rowBegin() ... rowEnd() of the rows 0, 1, ...
+      // visits the entries in row major order. A frozen entry takes 8 bytes.
       struct tSparseMatrix
-        : public tMap 
       {
 
+        /**
+         * @brief an entry of a row
+         */
+        struct tEntry
+        {
+          int j;
+          float value;
+        };
+
+        /**
+         * @brief an entry appended by add() and not frozen yet
+         */
+        struct tTriplet
+        {
+          int i;
+          int j;
+          float value;
+        };
+
         tSparseMatrix( int size )
-          : size_(size), tMap()
+          : size_(size), vecRowOffsets_(size + 1, 0)
         {
 
         }
 
         /** read a sparse matrix from text file */
         tSparseMatrix( std::string file_name )
-          : tMap(),size_(0)
+          : size_(0), vecRowOffsets_(1, 0)
         {
 
           std::ifstream file( file_name.c_str() );
@@ -80,7 +97,8 @@ namespace DIRD
           {
             std::string line;
             getline (file,line);
-            size_ = atoi(line.c_str());
+            size_ = std::max( 0, atoi(line.c_str()) );
+            vecRowOffsets_.assign( size_ + 1, 0 );
             while (file.good())
             {
               std::string word,line;
@@ -94,13 +112,15 @@ namespace DIRD
               iss >> word;
               float f = (float)atof(word.c_str());
 
-              if ( f>0.0000001 )
+              // entries outside the matrix (malformed file) are skipped
+              if ( f>0.0000001 && i>=0 && i<size_ && j>=0 && j<size_ )
               {
-                (*this)(i,j) = f;
+                add(i,j,f);
               }
 
             }
           }
+          freeze();
         }
 
         /**
@@ -112,34 +132,65 @@ namespace DIRD
         bool toImage( uint8_t * img, int img_size );
 
         /**
-         * @brief dumps the matrix to a text file (ASCII format)
+         * @brief dumps the matrix to a text file (ASCII format), row by row
          * @return true on success, false otherwise
          * @param file_name name of file
          */
         bool toFile( std::string file_name );
 
         /**
-         * @brief translate a 2d matrix index into 1d
-         * @return linear index
-         * @param i index 1
-         * @param j index 2
+         * @brief removes all entries (frozen or not)
          */
-        inline long getIdx( int i, int j )
+        void clear();
+
+        /**
+         * @brief appends an entry, it is visible after the next freeze()
+         * @param i index 1 (in [0,size_))
+         * @param j index 2 (in [0,size_))
+         * @param value value of the entry (the last one added wins if (i,j) is added twice)
+         */
+        inline void add( int i, int j, float value )
         {
-          return i * size_ + j;
+          assert( i >= 0 && i < size_ && j >= 0 && j < size_ );
+          tTriplet triplet = { i, j, value };
+          vecTriplets_.push_back( triplet );
         }
 
         /**
-         * @brief 2d index operator
-         * @return value at position (i,j) 
-         * @param i index 1
-         * @param j index 2
+         * @brief sorts the entries added since the last freeze() into the rows (they
+         * replace frozen entries at the same position) and releases the triplets
          */
-        inline float & operator()( int i, int j )
+        void freeze();
+
+        /**
+         * @brief number of (frozen) entries
+         */
+        inline size_t size() const
+        {
+          return vecEntries_.size();
+        }
+
+        /**
+         * @brief the entries of row i, sorted by column
+         */
+        inline const tEntry * rowBegin( int i ) const
+        {
+          return vecEntries_.data() + vecRowOffsets_[i];
+        }
+
+        inline const tEntry * rowEnd( int i ) const
         {
-          return (*this)[ getIdx(i,j) ];
+          return vecEntries_.data() + vecRowOffsets_[i+1];
         }
 
+        /**
+         * @brief the first entry of row i in a column >= j (binary search)
+         * @return pointer into the row, rowEnd(i) if there is none
+         * @param i index 1
+         * @param j index 2
+         */
+        const tEntry * lowerBound( int i, int j ) const;
+
         /**
          * @brief safely reads matrix element. A default value is returned if it doesnt exist
          * @return value at matrix position if it exists, default value otherwise
@@ -147,26 +198,90 @@ namespace DIRD
          * @param j index 2
          * @param default_value value which is returned if index doesnt exist
          */
-        inline float at( int i, int j, int default_value = 0 )
+        inline float at( int i, int j, int default_value = 0 ) const
         {
-          long idx = getIdx(i,j);
-          iterator iter = find(idx);
-          if ( iter == end() )
+          if (i < 0 || i >= size_)
           {
             return (float)default_value;
           }
-          return iter->second;
+          const tEntry * entry = lowerBound( i, j );
+          if ( entry == rowEnd(i) || entry->j != j )
+          {
+            return (float)default_value;
+          }
+          return entry->value;
         }
 
+        /**
+         * @brief groups the entries by anti-diagonal d = i+j in linear time (counting sort)
+         * @param diagonal_offsets the entries of anti-diagonal d are entries[diagonal_offsets[d]] 
+         * ... entries[diagonal_offsets[d+1]-1] (2*size_ offsets)
+         * @param entries indices into vecEntries_, sorted by increasing i (decreasing j) 
+         * along each anti-diagonal
+         */
+        void getAntiDiagonals( std::vector<int> & diagonal_offsets, std::vector<int> & entries ) const;
+
         /**
          * @brief size (=width=height) of matrix
          */
         int size_;
 
+        /**
+         * @brief the frozen entries row by row, row i starts at vecRowOffsets_[i] 
+         * (size_+1 offsets)
+         */
+        std::vector<tEntry> vecEntries_;
+        std::vector<int> vecRowOffsets_;
+
+        /**
+         * @brief the entries added since the last freeze()
+         */
+        std::vector<tTriplet> vecTriplets_;
+
+      };
+
+
+      /**
+       * @brief algorithms computing the pairwise similarity matrix (all yield the same result,
+       * SIMILARITY_ANN only if annPruningFactor_ is 1)
+       */
+      enum eSimilarityEngine
+      {
+        SIMILARITY_BRUTE_FORCE = 0, // one distance after another, row by row
+        SIMILARITY_TILED,           // cache blocked and register tiled (see computeSimilarityRows())
+        SIMILARITY_EARLY_EXIT,      // tiled, stops summing up distances beyond maxDistance_
+        SIMILARITY_CASCADE,         // skips pairs by lower bounds of their distance (see initSummaries())
+        SIMILARITY_ANN              // range search in a vantage point tree (see cVpTree and annPruningFactor_)
+      };
 
+      /**
+       * @brief algorithms computing the segment scores of postProcessSimilarities()
+       */
+      enum eSegmentEngine
+      {
+        SEGMENT_BANDED = 0,         // one dynamic programming per hypothesis (see segmentScore())
+        SEGMENT_SWEEP,              // one sweep over all columns sharing partial paths (see sweepSegments())
+        SEGMENT_VALIDATE            // SEGMENT_BANDED, reports the differences of SEGMENT_SWEEP to it
       };
 
-      typedef tSparseMatrix::iterator tSparseMatrixIterator;
+      /**
+       * @brief an entry of a sparse column of a matrix
+       */
+      struct tColumnEntry
+      {
+        int i;
+        float value;
+      };
+
+      /**
+       * @brief an entry of the similarity matrix found by one of the similarity engines
+       */
+      struct tSimilarityHit
+      {
+        int i;
+        int j;
+        float similarity;
+      };
 
     public: /* public methods */
 
@@ -187,6 +302,38 @@ namespace DIRD
        */
       bool computePairwiseSimilarity( int safety_margin );
 
+      /**
+       * @brief number of threads used by the parallel parts (see numThreads_)
+       * @return number of threads
+       */
+      int getNumThreads();
+
+      /**
+       * @brief computes the similarities of a block of rows of the similarity matrix.
+       * Can be called concurrently from several threads.
+       * @return true on success, false otherwise
+       * @param row_begin first row of the block
+       * @param row_end one past the last row of the block
+       * @param safety_margin minimum number of frames for a loop
+       * @param hits similarities above tau1_ are appended here sorted by (i,j)
+       * @param rejected rejected[d] is increased for every pair which was discarded after summing up 
+       * d * earlyExitChunk_ dimensions (SIMILARITY_EARLY_EXIT and SIMILARITY_CASCADE only, rejected[0]
+       * counts pairs discarded by their lower bounds)
+       */
+      bool computeSimilarityRows( int row_begin, int row_end, int safety_margin, 
+          std::vector<tSimilarityHit> & hits, std::vector<long> & rejected );
+
+      /**
+       * @brief computes the per-frame summaries vecCoarseSummaries_ and vecFineSummaries_ 
+       * whose distances are lower bounds of the distances of the feature vectors
+       */
+      void initSummaries();
+
+      /**
+       * @brief computes maxDistance_ and vecSimilarityLut_ from the parameters of the logistic function
+       */
+      void initSimilarityLut();
+
       /**
        * @brief computes all pairs of features that belong to the same place
        * @return true on success, false otherwise
@@ -194,8 +341,69 @@ namespace DIRD
        */
       bool postProcessSimilarities( int segment_length );
 
+      /**
+       * @brief computes the score of the best segment ending in a hypothesis (i,j) of
+       * matSimilarity_ (0-1-2-3 step model, see dynamicProgrammingBand())
+       * @return score
+       * @param i row of the hypothesis
+       * @param j column of the hypothesis
+       * @param value similarity at (i,j)
+       * @param segment_length length of segments that shall be matched 
+       * @param similarity_band buffer for the similarities of the band (reused across hypotheses)
+       * @param dp_band buffer for the scores of the band (reused across hypotheses)
+       */
+      float segmentScore( int i, int j, float value, int segment_length, 
+          std::vector<float> & similarity_band, std::vector<float> & dp_band );
+
+      /**
+       * @brief the dynamic programming of a segment ending in (i,j). The segment goes 
+       * back segment_length columns, each step back moves 0 ... 3 rows up. Hence all
+       * paths stay within a band of segment_length x (3*segment_length+1) cells: 
+       * row t of the band is column j-t of the matrix and band cell r of it is 
+       * row i - 3*segment_length + r of the matrix.
+       * @return the best score of all cells reached
+       * @param similarity_band the similarities of the band (rows 1 ... num_steps are read,
+       * within the rows of the matrix reachable from (i,j))
+       * @param dp_band the scores of the band (must be zero)
+       * @param i row of the hypothesis
+       * @param segment_length length of segments that shall be matched
+       * @param num_steps number of steps back, i.e. min(segment_length-1, j)
+       * @param value similarity at (i,j)
+       */
+      static float dynamicProgrammingBand( const float * similarity_band, float * dp_band, int i, 
+          int segment_length, int num_steps, float value );
+
+      /**
+       * @brief computes the segment scores of all hypotheses in one sweep over the columns
+       * of matSimilarity_. The best path of k steps ending in a cell is the similarity of 
+       * the cell plus the best path of k-1 steps ending in one of the (up to) four cells 
+       * of the previous column it can be reached from. These paths are kept for all
+       * k < segment_length for the previous and the current column (only for cells which 
+       * a path through a non-zero similarity reaches), so all hypotheses share them. The 
+       * scores equal those of segmentScore() up to the rounding of the float sums, which 
+       * are added up in the opposite order.
+       * @param segment_length length of segments that shall be matched 
+       * @param tau_2 similarity a hypothesis needs at least
+       * @param tau_3 scores above tau_3 * segment_length are stored
+       * @param result the scores of the hypotheses
+       */
+      void sweepSegments( int segment_length, float tau_2, float tau_3, tSparseMatrix & result );
+
       /**
        * @brief computes loops from post processed similarity matrix (basically a non-maxima supression)
+       *
+       * Every entry of matDynamicProgramming_ is the centre of a window, the 
+       * 2*non_max-1 places along its anti-diagonal (i-k,j+k) with |k| < non_max 
+       * (missing entries count as 0). All entries below the second largest value 
+       * of a window are suppressed, i.e. set to 0 in matLoopClosures_. The windows
+       * are evaluated on the unsuppressed values, so the result does not depend on
+       * the order of the entries (the same rule as cOnlinePlaceRecognizer).
+       *
+       * The entries are grouped by anti-diagonal (see tSparseMatrix::getAntiDiagonals()).
+       * Along each, the second largest value of every window and the largest of 
+       * these within non_max-1 places of every entry are found by sliding windows
+       * in linear time.
+       *
        * @return true on success, false otherwise
        * @param non_max size of non-maxima supression region in [number of places] 
        */
@@ -208,35 +416,50 @@ namespace DIRD
        * @param j index of second feature vector
        */
       inline long dist( int i, int j )
+      {
+        return pSadKernel_( &feature_vectors_[ (size_t)i * dim_feature_ ], &feature_vectors_[ (size_t)j * dim_feature_ ], dim_feature_ );
+      }
+
+      /**
+       * @brief computes the distance (SAD) between two feature vectors, but stops
+       * as soon as the distance exceeds a bound
+       * @return distance between two feature vectors if it is at most bound, some value above bound otherwise
+       * @param i index of first feature vector
+       * @param j index of second feature vector
+       * @param bound the maximal distance of interest
+       * @param depth number of chunks of earlyExitChunk_ dimensions that were summed up
+       */
+      inline long distBounded( int i, int j, long bound, int & depth )
       {
         long sum = 0;
-        uint8_t * feature1 = &feature_vectors_[ i * dim_feature_ ];
-        uint8_t * feature2 = &feature_vectors_[ j * dim_feature_ ];
-
-        // some SSE magic
-        // inspired by code of libViso2 (http://www.cvlibs.net/software/libviso2.html)
-        __m128i xmm1_1, xmm1_2;
-        __m128i xmm2_1, xmm2_2;
-        for (int k = 0; k < dim_feature_; k+=32)
+        depth = 0;
+        for (int k = 0; k < dim_feature_ && sum <= bound; k += earlyExitChunk_)
         {
-
-          xmm1_1 = _mm_load_si128((__m128i*)&feature1[k]);
-          xmm2_1 = _mm_load_si128((__m128i*)&feature2[k]);
-          xmm2_1 = _mm_sad_epu8 (xmm1_1, xmm2_1);
-
-          xmm1_2 = _mm_load_si128((__m128i*)&feature1[k+16]);
-          xmm2_2 = _mm_load_si128((__m128i*)&feature2[k+16]);
-          xmm2_2 = _mm_sad_epu8 (xmm1_2, xmm2_2);
-
-          xmm2_2 = _mm_add_epi16(xmm2_1, xmm2_2);
-
-          sum += _mm_extract_epi16(xmm2_2,0) + _mm_extract_epi16(xmm2_2,4);
-
+          int len = dim_feature_ - k < earlyExitChunk_ ? dim_feature_ - k : earlyExitChunk_;
+          sum += pSadKernel_( &feature_vectors_[ (size_t)i * dim_feature_ + k ], &feature_vectors_[ (size_t)j * dim_feature_ + k ], len );
+          depth++;
         }
-
         return sum;
       }
 
+      /**
+       * @brief translates a vector distance into a similarity score (0 ... 1) by a logistic function (sigmoid)
+       * @return similarity
+       * @param distance distance between two feature vectors (see dist())
+       */
+      inline float similarity( long distance )
+      {
+        return 1.0f - 1.0f/( 1.0f + exp( -( ((float)distance) - sigPar1_)/sigPar2_ ) );
+      }
+
+      /**
+       * @brief selects the SAD kernel used by dist(). By default the fastest kernel 
+       * supported by the CPU is used (see cSadKernel::detect()), specialised on 
+       * dim_feature_ if it is the dimension of cDird or cDirdCompact
+       * @param instruction_set requested instruction set (falls back to a supported one)
+       */
+      void setInstructionSet( cSadKernel::eInstructionSet instruction_set );
+
 
 
     public: /* attributes */
@@ -271,6 +494,113 @@ namespace DIRD
        */
       int num_features_;
 
+      /**
+       * @brief instruction set of the SAD kernel in use
+       */
+      cSadKernel::eInstructionSet instructionSet_;
+
+      /**
+       * @brief the SAD kernel in use (picked at runtime, see setInstructionSet())
+       */
+      cSadKernel::tSadFunction pSadKernel_;
+
+      /**
+       * @brief the SAD micro-tile kernel in use (see cSadKernel::tSadTileFunction)
+       */
+      cSadKernel::tSadTileFunction pSadTileKernel_;
+
+      /**
+       * @brief algorithm used by computePairwiseSimilarity() (default SIMILARITY_EARLY_EXIT)
+       */
+      eSimilarityEngine similarityEngine_;
+
+      /**
+       * @brief algorithm used by postProcessSimilarities() (default SEGMENT_BANDED)
+       */
+      eSegmentEngine segmentEngine_;
+
+      /**
+       * @brief number of rows (feature vectors) of the similarity matrix processed as one block
+       * by SIMILARITY_TILED. Together with colBlockSize_ a block should fit into the L2 cache.
+       */
+      static const int rowBlockSize_ = 64;
+
+      /**
+       * @brief number of threads used by computePairwiseSimilarity() and postProcessSimilarities(),
+       * 0 means one per core.
+       * Results do not depend on the number of threads.
+       */
+      int numThreads_;
+
+      /**
+       * @brief number of columns (feature vectors) of the similarity matrix processed as one block
+       */
+      static const int colBlockSize_ = 64;
+
+      /**
+       * @brief parameters of the logistic function (see similarity())
+       */
+      float sigPar1_;
+      float sigPar2_;
+
+      /**
+       * @brief similarities below this (very conservative) threshold are not stored in matSimilarity_
+       */
+      float tau1_;
+
+      /**
+       * @brief the largest distance whose similarity is above tau1_ (see initSimilarityLut())
+       */
+      long maxDistance_;
+
+      /**
+       * @brief similarities of the distances 0 ... maxDistance_ (see initSimilarityLut())
+       */
+      std::vector<float> vecSimilarityLut_;
+
+      /**
+       * @brief granularity (in dimensions) at which SIMILARITY_EARLY_EXIT checks the partial 
+       * distances against maxDistance_. A multiple of 64 to keep the SAD kernels efficient.
+       */
+      static const int earlyExitChunk_ = 384;
+
+      /**
+       * @brief number of groups of consecutive dimensions which are summed up to a 
+       * coarse and a fine per-frame summary (16 groups = one per tile for a 4x4 tiling)
+       */
+      static const int numCoarseGroups_ = 16;
+      static const int numFineGroups_ = 64;
+
+      /**
+       * @brief per-frame summaries (numCoarseGroups_ and numFineGroups_ sums per frame) 
+       * used by SIMILARITY_CASCADE (see initSummaries())
+       */
+      std::vector<int> vecCoarseSummaries_;
+      std::vector<int> vecFineSummaries_;
+
+      /**
+       * @brief statistics of the last computePairwiseSimilarity() run: number of pairs
+       * rejected after summing up d * earlyExitChunk_ dimensions (see computeSimilarityRows())
+       */
+      std::vector<long> vecRejectedAtDepth_;
+
+      /**
+       * @brief recall/speed knob of SIMILARITY_ANN: 1 finds all pairs within maxDistance_ (exact),
+       * smaller values search fewer subtrees of the vantage point tree and may miss some pairs
+       */
+      float annPruningFactor_;
+
+      /**
+       * @brief index over all feature vectors used by SIMILARITY_ANN (only during computePairwiseSimilarity())
+       */
+      cVpTree * pVpTree_;
+
+      /**
+       * @brief statistics of the last computePairwiseSimilarity() run with SIMILARITY_ANN: 
+       * number of distance computations
+       */
+      long numAnnDistances_;
+
 
 
   };
@@ -0,0 +1,776 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+#include "cSadKernel.h"
+#include "cDird.h"
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+
+#include <emmintrin.h>
+
+// the AVX kernels are compiled for their instruction set only (the rest of the
+// library is still built for SSE2/SSE3), they are picked at runtime via CPUID
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#include <immintrin.h>
+#define DIRD_HAVE_AVX2 1
+#define DIRD_TARGET_AVX2 __attribute__((target("avx2")))
+#if __GNUC__ >= 7 || defined(__clang__)
+#define DIRD_HAVE_AVX512 1
+#define DIRD_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+#endif
+#elif defined(_MSC_VER) && _MSC_VER >= 1700
+#include <immintrin.h>
+#include <intrin.h>
+#define DIRD_HAVE_AVX2 1
+#define DIRD_TARGET_AVX2
+#if _MSC_VER >= 1910
+#define DIRD_HAVE_AVX512 1
+#define DIRD_TARGET_AVX512
+#endif
+#endif
+
+using namespace std;
+
+namespace DIRD
+{
+
+#if defined(_MSC_VER) && defined(DIRD_HAVE_AVX2)
+  // checks CPUID feature bits and whether the OS saves the extended registers
+  static bool cpuSupports( cSadKernel::eInstructionSet instruction_set )
+  {
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+      return false;
+    }
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx     = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx)
+    {
+      return false;
+    }
+    unsigned long long xcr0 = _xgetbv(0);
+
+    __cpuidex(info, 7, 0);
+    if (instruction_set == cSadKernel::AVX2)
+    {
+      return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+    }
+    if (instruction_set == cSadKernel::AVX512BW)
+    {
+      return (xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+    }
+    return false;
+  }
+#endif
+
+  cSadKernel::eInstructionSet cSadKernel::detect()
+  {
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+    __builtin_cpu_init();
+#if defined(DIRD_HAVE_AVX512)
+    if (__builtin_cpu_supports("avx512bw"))
+    {
+      return AVX512BW;
+    }
+#endif
+    if (__builtin_cpu_supports("avx2"))
+    {
+      return AVX2;
+    }
+#elif defined(_MSC_VER) && defined(DIRD_HAVE_AVX2)
+#if defined(DIRD_HAVE_AVX512)
+    if (cpuSupports(AVX512BW))
+    {
+      return AVX512BW;
+    }
+#endif
+    if (cpuSupports(AVX2))
+    {
+      return AVX2;
+    }
+#endif
+    return SSE2;
+  }
+
+  cSadKernel::tSadFunction cSadKernel::get( eInstructionSet instruction_set )
+  {
+    // never hand out a kernel the CPU cannot execute
+    if (instruction_set > detect())
+    {
+      instruction_set = detect();
+    }
+
+    switch (instruction_set)
+    {
+      case SCALAR:
+        return &sadScalar;
+#if defined(DIRD_HAVE_AVX2)
+      case AVX2:
+        return &sadAVX2;
+#endif
+#if defined(DIRD_HAVE_AVX512)
+      case AVX512BW:
+        return &sadAVX512;
+#endif
+      default:
+        return &sadSSE2;
+    }
+  }
+
+  cSadKernel::tSadTileFunction cSadKernel::getTile( eInstructionSet instruction_set )
+  {
+    if (instruction_set > detect())
+    {
+      instruction_set = detect();
+    }
+
+    switch (instruction_set)
+    {
+      case SCALAR:
+        return &sadTileScalar;
+#if defined(DIRD_HAVE_AVX2)
+      case AVX2:
+        return &sadTileAVX2;
+#endif
+#if defined(DIRD_HAVE_AVX512)
+      case AVX512BW:
+        return &sadTileAVX512;
+#endif
+      default:
+        return &sadTileSSE2;
+    }
+  }
+
+  const char * cSadKernel::name( eInstructionSet instruction_set )
+  {
+    switch (instruction_set)
+    {
+      case SCALAR:
+        return "scalar";
+      case SSE2:
+        return "SSE2";
+      case AVX2:
+        return "AVX2";
+      case AVX512BW:
+        return "AVX-512BW";
+    }
+    return "unknown";
+  }
+
+  long cSadKernel::sadScalar( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    long sum = 0;
+    for (int k = 0; k < dim; ++k)
+    {
+      sum += abs( (int)feature1[k] - (int)feature2[k] );
+    }
+    return sum;
+  }
+
+  // the lower 64 bit lane of a SAD accumulator (only 32 bit are available on 32 bit targets)
+  static inline long lowerLane64( __m128i v )
+  {
+#if defined(__x86_64__) || defined(_M_X64)
+    return (long)_mm_cvtsi128_si64(v);
+#else
+    return (long)_mm_cvtsi128_si32(v);
+#endif
+  }
+
+  template <int Dim>
+  static inline long sadSSE2Fixed( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    if (Dim > 0)
+    {
+      dim = Dim;
+    }
+    long sum = 0;
+
+    // some SSE magic
+    // inspired by code of libViso2 (http://www.cvlibs.net/software/libviso2.html)
+    __m128i xmm1_1, xmm1_2;
+    __m128i xmm2_1, xmm2_2;
+    int k = 0;
+    for (; k + 32 <= dim; k+=32)
+    {
+
+      xmm1_1 = _mm_loadu_si128((const __m128i*)&feature1[k]);
+      xmm2_1 = _mm_loadu_si128((const __m128i*)&feature2[k]);
+      xmm2_1 = _mm_sad_epu8 (xmm1_1, xmm2_1);
+
+      xmm1_2 = _mm_loadu_si128((const __m128i*)&feature1[k+16]);
+      xmm2_2 = _mm_loadu_si128((const __m128i*)&feature2[k+16]);
+      xmm2_2 = _mm_sad_epu8 (xmm1_2, xmm2_2);
+
+      xmm2_2 = _mm_add_epi16(xmm2_1, xmm2_2);
+
+      sum += _mm_extract_epi16(xmm2_2,0) + _mm_extract_epi16(xmm2_2,4);
+
+    }
+
+    // dimensions which are not a multiple of 32
+    return sum + cSadKernel::sadScalar( feature1 + k, feature2 + k, dim - k );
+  }
+
+  template <int Dim>
+  static long sadSSE2Dim( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    if (dim == Dim)
+    {
+      return sadSSE2Fixed<Dim>( feature1, feature2, dim );
+    }
+    return sadSSE2Fixed<0>( feature1, feature2, dim );
+  }
+
+  long cSadKernel::sadSSE2( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    return sadSSE2Fixed<0>( feature1, feature2, dim );
+  }
+
+#if defined(DIRD_HAVE_AVX2)
+  template <int Dim>
+  DIRD_TARGET_AVX2
+  static inline long sadAVX2Fixed( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    if (Dim > 0)
+    {
+      dim = Dim;
+    }
+    // _mm256_sad_epu8 yields four 64 bit partial sums which are accumulated
+    // as they are. Only a single horizontal reduction is done at the very end.
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+    int k = 0;
+    for (; k + 64 <= dim; k+=64)
+    {
+      __m256i a1 = _mm256_loadu_si256((const __m256i*)&feature1[k]);
+      __m256i b1 = _mm256_loadu_si256((const __m256i*)&feature2[k]);
+      __m256i a2 = _mm256_loadu_si256((const __m256i*)&feature1[k+32]);
+      __m256i b2 = _mm256_loadu_si256((const __m256i*)&feature2[k+32]);
+      acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(a1, b1));
+      acc2 = _mm256_add_epi64(acc2, _mm256_sad_epu8(a2, b2));
+    }
+    if (k + 32 <= dim)
+    {
+      __m256i a1 = _mm256_loadu_si256((const __m256i*)&feature1[k]);
+      __m256i b1 = _mm256_loadu_si256((const __m256i*)&feature2[k]);
+      acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(a1, b1));
+      k += 32;
+    }
+    acc1 = _mm256_add_epi64(acc1, acc2);
+
+    // horizontal reduction
+    __m128i sum128 = _mm_add_epi64(_mm256_castsi256_si128(acc1), _mm256_extracti128_si256(acc1, 1));
+    sum128 = _mm_add_epi64(sum128, _mm_unpackhi_epi64(sum128, sum128));
+    long sum = lowerLane64(sum128);
+
+    return sum + cSadKernel::sadScalar( feature1 + k, feature2 + k, dim - k );
+  }
+
+  template <int Dim>
+  DIRD_TARGET_AVX2
+  static long sadAVX2Dim( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    if (dim == Dim)
+    {
+      return sadAVX2Fixed<Dim>( feature1, feature2, dim );
+    }
+    return sadAVX2Fixed<0>( feature1, feature2, dim );
+  }
+
+  DIRD_TARGET_AVX2
+  long cSadKernel::sadAVX2( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    return sadAVX2Fixed<0>( feature1, feature2, dim );
+  }
+#else
+  long cSadKernel::sadAVX2( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    return sadSSE2( feature1, feature2, dim );
+  }
+#endif
+
+#if defined(DIRD_HAVE_AVX512)
+  template <int Dim>
+  DIRD_TARGET_AVX512
+  static inline long sadAVX512Fixed( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    if (Dim > 0)
+    {
+      dim = Dim;
+    }
+    // same scheme as the AVX2 kernel with eight 64 bit lanes
+    __m512i acc1 = _mm512_setzero_si512();
+    __m512i acc2 = _mm512_setzero_si512();
+    int k = 0;
+    for (; k + 128 <= dim; k+=128)
+    {
+      __m512i a1 = _mm512_loadu_si512((const void*)&feature1[k]);
+      __m512i b1 = _mm512_loadu_si512((const void*)&feature2[k]);
+      __m512i a2 = _mm512_loadu_si512((const void*)&feature1[k+64]);
+      __m512i b2 = _mm512_loadu_si512((const void*)&feature2[k+64]);
+      acc1 = _mm512_add_epi64(acc1, _mm512_sad_epu8(a1, b1));
+      acc2 = _mm512_add_epi64(acc2, _mm512_sad_epu8(a2, b2));
+    }
+    if (k + 64 <= dim)
+    {
+      __m512i a1 = _mm512_loadu_si512((const void*)&feature1[k]);
+      __m512i b1 = _mm512_loadu_si512((const void*)&feature2[k]);
+      acc1 = _mm512_add_epi64(acc1, _mm512_sad_epu8(a1, b1));
+      k += 64;
+    }
+    if (k + 32 <= dim)
+    {
+      __m256i a1 = _mm256_loadu_si256((const __m256i*)&feature1[k]);
+      __m256i b1 = _mm256_loadu_si256((const __m256i*)&feature2[k]);
+      acc2 = _mm512_add_epi64(acc2, _mm512_zextsi256_si512(_mm256_sad_epu8(a1, b1)));
+      k += 32;
+    }
+    acc1 = _mm512_add_epi64(acc1, acc2);
+
+    // horizontal reduction
+    long sum = (long)_mm512_reduce_add_epi64(acc1);
+
+    return sum + cSadKernel::sadScalar( feature1 + k, feature2 + k, dim - k );
+  }
+
+  template <int Dim>
+  DIRD_TARGET_AVX512
+  static long sadAVX512Dim( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    if (dim == Dim)
+    {
+      return sadAVX512Fixed<Dim>( feature1, feature2, dim );
+    }
+    return sadAVX512Fixed<0>( feature1, feature2, dim );
+  }
+
+  DIRD_TARGET_AVX512
+  long cSadKernel::sadAVX512( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    return sadAVX512Fixed<0>( feature1, feature2, dim );
+  }
+#else
+  long cSadKernel::sadAVX512( const uint8_t * feature1, const uint8_t * feature2, int dim )
+  {
+    return sadAVX2( feature1, feature2, dim );
+  }
+#endif
+
+  void cSadKernel::sadTileScalar( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    for (int r = 0; r < tileSize_; ++r)
+    {
+      for (int c = 0; c < tileSize_; ++c)
+      {
+        distances[ r * tileSize_ + c ] = sadScalar( features1 + r * stride, features2 + c * stride, dim );
+      }
+    }
+  }
+
+  // adds the scalar distances of the last (dim - k) dimensions to a micro-tile
+  static inline void sadTileTail( const uint8_t * features1, const uint8_t * features2, int stride, int k, int dim, long * distances )
+  {
+    if (k == dim)
+    {
+      return;
+    }
+    for (int r = 0; r < cSadKernel::tileSize_; ++r)
+    {
+      for (int c = 0; c < cSadKernel::tileSize_; ++c)
+      {
+        distances[ r * cSadKernel::tileSize_ + c ] += 
+          cSadKernel::sadScalar( features1 + r * stride + k, features2 + c * stride + k, dim - k );
+      }
+    }
+  }
+
+  template <int Dim>
+  static inline void sadTileSSE2Fixed( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    if (Dim > 0)
+    {
+      dim = Dim;
+    }
+    // Two distances share one accumulator: the partial sums of _mm_sad_epu8 are
+    // at most 16 bit wide, so the second one is shifted into the upper 32 bit of
+    // each 64 bit lane. Thereby the 4x4 accumulators plus the loaded feature
+    // chunks fit into the 16 available registers.
+    __m128i acc[ 2 * cSadKernel::tileSize_ ];
+    for (int a = 0; a < 2 * cSadKernel::tileSize_; ++a)
+    {
+      acc[a] = _mm_setzero_si128();
+    }
+
+    int k = 0;
+    for (; k + 16 <= dim; k+=16)
+    {
+      __m128i b0 = _mm_loadu_si128((const __m128i*)&features2[ k ]);
+      __m128i b1 = _mm_loadu_si128((const __m128i*)&features2[ stride + k ]);
+      __m128i b2 = _mm_loadu_si128((const __m128i*)&features2[ 2 * stride + k ]);
+      __m128i b3 = _mm_loadu_si128((const __m128i*)&features2[ 3 * stride + k ]);
+      for (int r = 0; r < cSadKernel::tileSize_; ++r)
+      {
+        __m128i a = _mm_loadu_si128((const __m128i*)&features1[ r * stride + k ]);
+        acc[ 2 * r ]     = _mm_add_epi64(acc[ 2 * r ], 
+            _mm_or_si128(_mm_sad_epu8(a, b0), _mm_slli_epi64(_mm_sad_epu8(a, b1), 32)));
+        acc[ 2 * r + 1 ] = _mm_add_epi64(acc[ 2 * r + 1 ], 
+            _mm_or_si128(_mm_sad_epu8(a, b2), _mm_slli_epi64(_mm_sad_epu8(a, b3), 32)));
+      }
+    }
+
+    // horizontal reduction (separately for the lower and upper 32 bit)
+    const __m128i mask = _mm_set_epi32(0, -1, 0, -1);
+    for (int a = 0; a < 2 * cSadKernel::tileSize_; ++a)
+    {
+      __m128i lo = _mm_and_si128(acc[a], mask);
+      __m128i hi = _mm_srli_epi64(acc[a], 32);
+      lo = _mm_add_epi64(lo, _mm_unpackhi_epi64(lo, lo));
+      hi = _mm_add_epi64(hi, _mm_unpackhi_epi64(hi, hi));
+      distances[ 2 * a ]     = lowerLane64(lo);
+      distances[ 2 * a + 1 ] = lowerLane64(hi);
+    }
+
+    sadTileTail( features1, features2, stride, k, dim, distances );
+  }
+
+  template <int Dim>
+  static void sadTileSSE2Dim( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    if (dim == Dim)
+    {
+      sadTileSSE2Fixed<Dim>( features1, features2, stride, dim, distances );
+      return;
+    }
+    sadTileSSE2Fixed<0>( features1, features2, stride, dim, distances );
+  }
+
+  void cSadKernel::sadTileSSE2( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    sadTileSSE2Fixed<0>( features1, features2, stride, dim, distances );
+  }
+
+#if defined(DIRD_HAVE_AVX2)
+  template <int Dim>
+  DIRD_TARGET_AVX2
+  static inline void sadTileAVX2Fixed( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    if (Dim > 0)
+    {
+      dim = Dim;
+    }
+    // same packing scheme as the SSE2 micro-tile kernel
+    __m256i acc[ 2 * cSadKernel::tileSize_ ];
+    for (int a = 0; a < 2 * cSadKernel::tileSize_; ++a)
+    {
+      acc[a] = _mm256_setzero_si256();
+    }
+
+    int k = 0;
+    for (; k + 32 <= dim; k+=32)
+    {
+      __m256i b0 = _mm256_loadu_si256((const __m256i*)&features2[ k ]);
+      __m256i b1 = _mm256_loadu_si256((const __m256i*)&features2[ stride + k ]);
+      __m256i b2 = _mm256_loadu_si256((const __m256i*)&features2[ 2 * stride + k ]);
+      __m256i b3 = _mm256_loadu_si256((const __m256i*)&features2[ 3 * stride + k ]);
+      for (int r = 0; r < cSadKernel::tileSize_; ++r)
+      {
+        __m256i a = _mm256_loadu_si256((const __m256i*)&features1[ r * stride + k ]);
+        acc[ 2 * r ]     = _mm256_add_epi64(acc[ 2 * r ], 
+            _mm256_or_si256(_mm256_sad_epu8(a, b0), _mm256_slli_epi64(_mm256_sad_epu8(a, b1), 32)));
+        acc[ 2 * r + 1 ] = _mm256_add_epi64(acc[ 2 * r + 1 ], 
+            _mm256_or_si256(_mm256_sad_epu8(a, b2), _mm256_slli_epi64(_mm256_sad_epu8(a, b3), 32)));
+      }
+    }
+
+    const __m256i mask = _mm256_set_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+    for (int a = 0; a < 2 * cSadKernel::tileSize_; ++a)
+    {
+      __m256i lo = _mm256_and_si256(acc[a], mask);
+      __m256i hi = _mm256_srli_epi64(acc[a], 32);
+      __m128i lo128 = _mm_add_epi64(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1));
+      __m128i hi128 = _mm_add_epi64(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1));
+      lo128 = _mm_add_epi64(lo128, _mm_unpackhi_epi64(lo128, lo128));
+      hi128 = _mm_add_epi64(hi128, _mm_unpackhi_epi64(hi128, hi128));
+      distances[ 2 * a ]     = lowerLane64(lo128);
+      distances[ 2 * a + 1 ] = lowerLane64(hi128);
+    }
+
+    sadTileTail( features1, features2, stride, k, dim, distances );
+  }
+
+  template <int Dim>
+  DIRD_TARGET_AVX2
+  static void sadTileAVX2Dim( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    if (dim == Dim)
+    {
+      sadTileAVX2Fixed<Dim>( features1, features2, stride, dim, distances );
+      return;
+    }
+    sadTileAVX2Fixed<0>( features1, features2, stride, dim, distances );
+  }
+
+  DIRD_TARGET_AVX2
+  void cSadKernel::sadTileAVX2( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    sadTileAVX2Fixed<0>( features1, features2, stride, dim, distances );
+  }
+#else
+  void cSadKernel::sadTileAVX2( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    sadTileSSE2( features1, features2, stride, dim, distances );
+  }
+#endif
+
+#if defined(DIRD_HAVE_AVX512)
+  template <int Dim>
+  DIRD_TARGET_AVX512
+  static inline void sadTileAVX512Fixed( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    if (Dim > 0)
+    {
+      dim = Dim;
+    }
+    // 32 registers are plenty for 16 separate accumulators
+    __m512i acc[ cSadKernel::tileSize_ * cSadKernel::tileSize_ ];
+    for (int a = 0; a < cSadKernel::tileSize_ * cSadKernel::tileSize_; ++a)
+    {
+      acc[a] = _mm512_setzero_si512();
+    }
+
+    int k = 0;
+    for (; k + 64 <= dim; k+=64)
+    {
+      __m512i b0 = _mm512_loadu_si512((const void*)&features2[ k ]);
+      __m512i b1 = _mm512_loadu_si512((const void*)&features2[ stride + k ]);
+      __m512i b2 = _mm512_loadu_si512((const void*)&features2[ 2 * stride + k ]);
+      __m512i b3 = _mm512_loadu_si512((const void*)&features2[ 3 * stride + k ]);
+      for (int r = 0; r < cSadKernel::tileSize_; ++r)
+      {
+        __m512i a = _mm512_loadu_si512((const void*)&features1[ r * stride + k ]);
+        acc[ r * cSadKernel::tileSize_     ] = _mm512_add_epi64(acc[ r * cSadKernel::tileSize_     ], _mm512_sad_epu8(a, b0));
+        acc[ r * cSadKernel::tileSize_ + 1 ] = _mm512_add_epi64(acc[ r * cSadKernel::tileSize_ + 1 ], _mm512_sad_epu8(a, b1));
+        acc[ r * cSadKernel::tileSize_ + 2 ] = _mm512_add_epi64(acc[ r * cSadKernel::tileSize_ + 2 ], _mm512_sad_epu8(a, b2));
+        acc[ r * cSadKernel::tileSize_ + 3 ] = _mm512_add_epi64(acc[ r * cSadKernel::tileSize_ + 3 ], _mm512_sad_epu8(a, b3));
+      }
+    }
+
+    for (int a = 0; a < cSadKernel::tileSize_ * cSadKernel::tileSize_; ++a)
+    {
+      distances[a] = (long)_mm512_reduce_add_epi64(acc[a]);
+    }
+
+    sadTileTail( features1, features2, stride, k, dim, distances );
+  }
+
+  template <int Dim>
+  DIRD_TARGET_AVX512
+  static void sadTileAVX512Dim( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    if (dim == Dim)
+    {
+      sadTileAVX512Fixed<Dim>( features1, features2, stride, dim, distances );
+      return;
+    }
+    sadTileAVX512Fixed<0>( features1, features2, stride, dim, distances );
+  }
+
+  DIRD_TARGET_AVX512
+  void cSadKernel::sadTileAVX512( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    sadTileAVX512Fixed<0>( features1, features2, stride, dim, distances );
+  }
+#else
+  void cSadKernel::sadTileAVX512( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances )
+  {
+    sadTileAVX2( features1, features2, stride, dim, distances );
+  }
+#endif
+
+  // kernels of all instruction sets which are specialised on dimension Dim
+  template <int Dim>
+  static cSadKernel::tSadFunction getFixed( cSadKernel::eInstructionSet instruction_set )
+  {
+    switch (instruction_set)
+    {
+      case cSadKernel::SCALAR:
+        return &cSadKernel::sadScalar;
+#if defined(DIRD_HAVE_AVX2)
+      case cSadKernel::AVX2:
+        return &sadAVX2Dim<Dim>;
+#endif
+#if defined(DIRD_HAVE_AVX512)
+      case cSadKernel::AVX512BW:
+        return &sadAVX512Dim<Dim>;
+#endif
+      default:
+        return &sadSSE2Dim<Dim>;
+    }
+  }
+
+  template <int Dim>
+  static cSadKernel::tSadTileFunction getTileFixed( cSadKernel::eInstructionSet instruction_set )
+  {
+    switch (instruction_set)
+    {
+      case cSadKernel::SCALAR:
+        return &cSadKernel::sadTileScalar;
+#if defined(DIRD_HAVE_AVX2)
+      case cSadKernel::AVX2:
+        return &sadTileAVX2Dim<Dim>;
+#endif
+#if defined(DIRD_HAVE_AVX512)
+      case cSadKernel::AVX512BW:
+        return &sadTileAVX512Dim<Dim>;
+#endif
+      default:
+        return &sadTileSSE2Dim<Dim>;
+    }
+  }
+
+  cSadKernel::tSadFunction cSadKernel::get( eInstructionSet instruction_set, int dim )
+  {
+    if (instruction_set > detect())
+    {
+      instruction_set = detect();
+    }
+
+    // the dimensions of the descriptor geometries of cDird.h
+    switch (dim)
+    {
+      case cDird::iFrameDim_:
+        return getFixed<cDird::iFrameDim_>( instruction_set );
+      case cDirdCompact::iFrameDim_:
+        return getFixed<cDirdCompact::iFrameDim_>( instruction_set );
+      default:
+        return get( instruction_set );
+    }
+  }
+
+  cSadKernel::tSadTileFunction cSadKernel::getTile( eInstructionSet instruction_set, int dim )
+  {
+    if (instruction_set > detect())
+    {
+      instruction_set = detect();
+    }
+
+    switch (dim)
+    {
+      case cDird::iFrameDim_:
+        return getTileFixed<cDird::iFrameDim_>( instruction_set );
+      case cDirdCompact::iFrameDim_:
+        return getTileFixed<cDirdCompact::iFrameDim_>( instruction_set );
+      default:
+        return getTile( instruction_set );
+    }
+  }
+
+  bool cSadKernel::selfTest()
+  {
+    // a few dimensions (including odd ones which exercise the tails) and
+    // some extreme vectors (all 0 vs. all 255) which would overflow narrow accumulators
+    static const int dims[] = { 1, 31, 32, 33, 63, 64, 127, 216, 648, 3456, 3456 * 3 };
+    static const int num_dims = sizeof(dims)/sizeof(dims[0]);
+    static const int max_dim = 3456 * 3;
+
+    vector<uint8_t> feature1( max_dim ), feature2( max_dim );
+    eInstructionSet best = detect();
+
+    srand(42);
+    for (int t = 0; t < 3 * num_dims; ++t)
+    {
+      int dim = dims[ t % num_dims ];
+      for (int k = 0; k < dim; ++k)
+      {
+        switch (t / num_dims)
+        {
+          case 0:
+            feature1[k] = (uint8_t)(rand() % 256);
+            feature2[k] = (uint8_t)(rand() % 256);
+            break;
+          case 1:
+            feature1[k] = 0;
+            feature2[k] = 255;
+            break;
+          default:
+            feature1[k] = (uint8_t)(100 + rand() % 20);
+            feature2[k] = (uint8_t)(100 + rand() % 20);
+        }
+      }
+
+      long reference = sadScalar( &feature1[0], &feature2[0], dim );
+      for (int s = SSE2; s <= best; ++s)
+      {
+        // the generic kernel and the one specialised on dim (if any)
+        long distance = get( (eInstructionSet)s )( &feature1[0], &feature2[0], dim );
+        long distance_fixed = get( (eInstructionSet)s, dim )( &feature1[0], &feature2[0], dim );
+        if (distance != reference || distance_fixed != reference)
+        {
+          cerr << "SAD kernel " << name( (eInstructionSet)s ) << " returned " << distance
+            << " / " << distance_fixed << " instead of " << reference << " (dim " << dim << ")\n";
+          return false;
+        }
+      }
+    }
+
+    // micro-tile kernels (on consecutive random feature vectors)
+    static const int tile_dims[] = { 1, 17, 33, 64, 100, 216, 648, 3456 };
+    vector<uint8_t> features( 2 * tileSize_ * 3456 );
+    for (size_t k = 0; k < features.size(); ++k)
+    {
+      features[k] = (uint8_t)(rand() % 256);
+    }
+    for (size_t t = 0; t < sizeof(tile_dims)/sizeof(tile_dims[0]); ++t)
+    {
+      int dim = tile_dims[t];
+      const uint8_t * features1 = &features[0];
+      const uint8_t * features2 = &features[ tileSize_ * dim ];
+      long reference[ tileSize_ * tileSize_ ];
+      sadTileScalar( features1, features2, dim, dim, reference );
+      for (int s = SSE2; s <= best; ++s)
+      {
+        long distances[ tileSize_ * tileSize_ ];
+        long distances_fixed[ tileSize_ * tileSize_ ];
+        getTile( (eInstructionSet)s )( features1, features2, dim, dim, distances );
+        getTile( (eInstructionSet)s, dim )( features1, features2, dim, dim, distances_fixed );
+        for (int d = 0; d < tileSize_ * tileSize_; ++d)
+        {
+          if (distances[d] != reference[d] || distances_fixed[d] != reference[d])
+          {
+            cerr << "SAD tile kernel " << name( (eInstructionSet)s ) << " returned " << distances[d]
+              << " / " << distances_fixed[d] << " instead of " << reference[d] << " (dim " << dim << ")\n";
+            return false;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+}
@@ -0,0 +1,164 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#pragma once
+
+#if _MSC_VER <= 1500
+typedef unsigned char uint8_t;
+#else
+#include <stdint.h>
+#endif
+
+namespace DIRD
+{
+
+  /*@class cSadKernel
+   *
+   * Computes the sum of absolute differences (SAD) between two uint8_t
+   * feature vectors. Several implementations exist (SSE2, AVX2, AVX-512BW)
+   * and the fastest one supported by the executing CPU is picked at runtime
+   * (see detect() and get()). All implementations return bit-identical
+   * distances which can be checked with selfTest().
+   *
+   */
+  class cSadKernel
+  {
+
+    public: /* public classes/enums/types etc... */
+
+      /**
+       * @brief signature of a SAD kernel
+       */
+      typedef long (*tSadFunction)( const uint8_t * feature1, const uint8_t * feature2, int dim );
+
+      /**
+       * @brief signature of a SAD micro-tile kernel. It computes the distances between
+       * tileSize_ consecutive feature vectors starting at features1 and tileSize_
+       * consecutive feature vectors starting at features2 (row major into distances).
+       */
+      typedef void (*tSadTileFunction)( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances );
+
+      /**
+       * @brief supported instruction sets (ordered from slowest to fastest)
+       */
+      enum eInstructionSet
+      {
+        SCALAR = 0,
+        SSE2,
+        AVX2,
+        AVX512BW
+      };
+
+    public: /* public methods */
+
+      /**
+       * @brief detects the best instruction set supported by the CPU (via CPUID)
+       * @return fastest instruction set that can be executed
+       */
+      static eInstructionSet detect();
+
+      /**
+       * @brief returns the SAD kernel for an instruction set
+       * @return pointer to kernel, falls back to SSE2 if the instruction set is not supported
+       * @param instruction_set requested instruction set
+       */
+      static tSadFunction get( eInstructionSet instruction_set );
+
+      /**
+       * @brief returns the SAD micro-tile kernel for an instruction set
+       * @return pointer to kernel, falls back to SSE2 if the instruction set is not supported
+       * @param instruction_set requested instruction set
+       */
+      static tSadTileFunction getTile( eInstructionSet instruction_set );
+
+      /**
+       * @brief returns the SAD kernel for an instruction set which is specialised on a
+       * dimension (the kernels for the dimensions of cDird and cDirdCompact have
+       * constant trip counts and no tails). The kernel accepts any dimension but is
+       * fastest for dim.
+       * @return pointer to kernel, the generic one if there is no specialisation for dim
+       * @param instruction_set requested instruction set
+       * @param dim dimension of the feature vectors
+       */
+      static tSadFunction get( eInstructionSet instruction_set, int dim );
+
+      /**
+       * @brief returns the SAD micro-tile kernel specialised on a dimension (see get())
+       * @return pointer to kernel, the generic one if there is no specialisation for dim
+       * @param instruction_set requested instruction set
+       * @param dim dimension of the feature vectors
+       */
+      static tSadTileFunction getTile( eInstructionSet instruction_set, int dim );
+
+      /**
+       * @brief human readable name of an instruction set
+       * @return name
+       * @param instruction_set the instruction set
+       */
+      static const char * name( eInstructionSet instruction_set );
+
+      /**
+       * @brief checks that all supported kernels produce bit-identical distances
+       * @return true if all kernels agree with the scalar reference, false otherwise
+       */
+      static bool selfTest();
+
+      /**
+       * @brief scalar reference implementation
+       */
+      static long sadScalar( const uint8_t * feature1, const uint8_t * feature2, int dim );
+
+      /**
+       * @brief SSE2 implementation (always available)
+       * inspired by code of libViso2 (http://www.cvlibs.net/software/libviso2.html)
+       */
+      static long sadSSE2( const uint8_t * feature1, const uint8_t * feature2, int dim );
+
+      /**
+       * @brief AVX2 implementation. Must only be called if detect() >= AVX2
+       */
+      static long sadAVX2( const uint8_t * feature1, const uint8_t * feature2, int dim );
+
+      /**
+       * @brief AVX-512BW implementation. Must only be called if detect() >= AVX512BW
+       */
+      static long sadAVX512( const uint8_t * feature1, const uint8_t * feature2, int dim );
+
+      /**
+       * @brief micro-tile kernels (see tSadTileFunction), one per instruction set
+       */
+      static void sadTileScalar( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances );
+      static void sadTileSSE2( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances );
+      static void sadTileAVX2( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances );
+      static void sadTileAVX512( const uint8_t * features1, const uint8_t * features2, int stride, int dim, long * distances );
+
+    public: /* attributes */
+
+      /**
+       * @brief number of feature vectors per side of a micro-tile (tileSize_ x tileSize_ distances)
+       */
+      static const int tileSize_ = 4;
+
+  };
+}
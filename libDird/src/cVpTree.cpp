@@ -0,0 +1,166 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+#include "cVpTree.h"
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+namespace DIRD
+{
+  cVpTree::cVpTree( const uint8_t * feature_vectors, int num_features, int dim_feature, cSadKernel::tSadFunction sad_kernel )
+    : feature_vectors_(feature_vectors),
+    num_features_(num_features),
+    dim_feature_(dim_feature),
+    pSadKernel_(sad_kernel)
+  {
+
+  }
+
+  cVpTree::~cVpTree()
+  {
+
+  }
+
+  void cVpTree::build()
+  {
+    vecNodes_.clear();
+    vecIndices_.resize( num_features_ );
+    for (int i = 0; i < num_features_; ++i)
+    {
+      vecIndices_[i] = i;
+    }
+    vecNodes_.reserve( 2 * num_features_ / leafSize_ + 1 );
+    buildNode( 0, num_features_ );
+  }
+
+  int cVpTree::buildNode( int begin, int end )
+  {
+    tNode node;
+    node.vantage_point = -1;
+    node.mu = 0;
+    node.inside = -1;
+    node.outside = -1;
+    node.begin = begin;
+    node.end = end;
+
+    int id = (int)vecNodes_.size();
+    vecNodes_.push_back( node );
+
+    // small subtrees become leaves
+    if (end - begin <= leafSize_)
+    {
+      return id;
+    }
+
+    // pick a (deterministic) pseudo random vantage point and move it to the front
+    int pick = begin + (int)( ((unsigned int)begin * 2654435761u) % (unsigned int)(end - begin) );
+    swap( vecIndices_[begin], vecIndices_[pick] );
+    int vantage_point = vecIndices_[begin];
+    const uint8_t * feature = &feature_vectors_[ (size_t)vantage_point * dim_feature_ ];
+
+    // split the remaining points at their median distance to the vantage point
+    vector< pair<long,int> > distances;
+    distances.reserve( end - begin - 1 );
+    for (int k = begin + 1; k < end; ++k)
+    {
+      int idx = vecIndices_[k];
+      distances.push_back( make_pair( pSadKernel_( feature, &feature_vectors_[ (size_t)idx * dim_feature_ ], dim_feature_ ), idx ) );
+    }
+    int mid = (int)distances.size() / 2;
+    nth_element( distances.begin(), distances.begin() + mid, distances.end() );
+    for (size_t k = 0; k < distances.size(); ++k)
+    {
+      vecIndices_[ begin + 1 + k ] = distances[k].second;
+    }
+    long mu = distances[mid].first;
+
+    int inside = buildNode( begin + 1, begin + 1 + mid );
+    int outside = buildNode( begin + 1 + mid, end );
+
+    // vecNodes_ may have been reallocated by the recursion
+    vecNodes_[id].vantage_point = vantage_point;
+    vecNodes_[id].mu = mu;
+    vecNodes_[id].inside = inside;
+    vecNodes_[id].outside = outside;
+    return id;
+  }
+
+  long cVpTree::findWithinRadius( int query, long radius, float pruning_factor, vector<tNeighbour> & neighbours ) const
+  {
+    if (vecNodes_.empty())
+    {
+      return 0;
+    }
+
+    long num_distances = 0;
+    long prune_radius = (long)(radius * pruning_factor);
+
+    // depth first traversal with an explicit stack
+    vector<int> stack;
+    stack.push_back( 0 );
+    while (!stack.empty())
+    {
+      const tNode & node = vecNodes_[ stack.back() ];
+      stack.pop_back();
+
+      if (node.vantage_point < 0)
+      {
+        for (int k = node.begin; k < node.end; ++k)
+        {
+          long distance = distBounded( query, vecIndices_[k], radius );
+          num_distances++;
+          if (distance <= radius)
+          {
+            tNeighbour neighbour = { vecIndices_[k], distance };
+            neighbours.push_back( neighbour );
+          }
+        }
+        continue;
+      }
+
+      // the exact distance is needed only up to mu + radius for the pruning below
+      long distance = distBounded( query, node.vantage_point, node.mu + max( radius, prune_radius ) );
+      num_distances++;
+      if (distance <= radius)
+      {
+        tNeighbour neighbour = { node.vantage_point, distance };
+        neighbours.push_back( neighbour );
+      }
+
+      // by the triangle inequality all neighbours have a distance to the 
+      // vantage point in [distance - radius, distance + radius]
+      if (distance - prune_radius <= node.mu)
+      {
+        stack.push_back( node.inside );
+      }
+      if (distance + prune_radius >= node.mu)
+      {
+        stack.push_back( node.outside );
+      }
+    }
+
+    return num_distances;
+  }
+}
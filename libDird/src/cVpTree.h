@@ -0,0 +1,174 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#pragma once
+
+#if _MSC_VER <= 1500
+typedef unsigned char uint8_t;
+#else
+#include <stdint.h>
+#endif
+
+#include <stddef.h>
+#include <vector>
+
+#include "cSadKernel.h"
+
+namespace DIRD
+{
+
+  /*@class cVpTree
+   *
+   * A vantage point tree over feature vectors under the SAD (L1) metric.
+   * It answers "which feature vectors are within a given distance of feature
+   * vector i" without comparing i to all others (see findWithinRadius()).
+   *
+   * The search is exact for a pruning factor of 1. Smaller factors prune more
+   * aggressively and trade recall for speed. Neighbours that are reported are
+   * always within the radius (there are no false positives).
+   *
+   */
+  class cVpTree
+  {
+
+    public: /* public classes/enums/types etc... */
+
+      /**
+       * @brief a node of the tree. Leaves store a range of vecIndices_, inner nodes
+       * a vantage point and the median distance mu of their points to it
+       */
+      struct tNode
+      {
+        int vantage_point;  // index of feature vector, -1 for leaves
+        long mu;            // points of child inside are at most mu away from vantage_point, outside at least
+        int inside;         // node index of inner child
+        int outside;        // node index of outer child
+        int begin;          // first entry of vecIndices_ (leaves only)
+        int end;            // one past the last entry of vecIndices_ (leaves only)
+      };
+
+      /**
+       * @brief a neighbour found by findWithinRadius()
+       */
+      struct tNeighbour
+      {
+        int index;
+        long distance;
+      };
+
+    public: /* public methods */
+
+      /**
+       * construct a cVpTree object from scratch. The feature vectors are not copied.
+       */
+      cVpTree( const uint8_t * feature_vectors, int num_features, int dim_feature, cSadKernel::tSadFunction sad_kernel );
+
+      /**
+       * destruct a cVpTree object
+       */
+      ~cVpTree();
+
+      /**
+       * @brief builds the tree (O(N log N) distance computations)
+       */
+      void build();
+
+      /**
+       * @brief recursively builds the subtree over vecIndices_[begin,end)
+       * @return node index of the subtree's root
+       */
+      int buildNode( int begin, int end );
+
+      /**
+       * @brief finds all feature vectors within a distance of a feature vector (itself included)
+       * @param query index of the query feature vector
+       * @param radius maximal distance of neighbours
+       * @param pruning_factor 1 for an exact search, values in (0,1) prune subtrees
+       * more aggressively (faster, but some neighbours may be missed)
+       * @param neighbours neighbours are appended here (unsorted)
+       * @return number of distance computations
+       */
+      long findWithinRadius( int query, long radius, float pruning_factor, std::vector<tNeighbour> & neighbours ) const;
+
+      /**
+       * @brief computes the distance between two feature vectors but stops once it exceeds bound
+       * @return distance if it is at most bound, some value above bound otherwise
+       */
+      inline long distBounded( int i, int j, long bound ) const
+      {
+        const uint8_t * feature1 = &feature_vectors_[ (size_t)i * dim_feature_ ];
+        const uint8_t * feature2 = &feature_vectors_[ (size_t)j * dim_feature_ ];
+        long sum = 0;
+        for (int k = 0; k < dim_feature_ && sum <= bound; k += chunkSize_)
+        {
+          int len = dim_feature_ - k < chunkSize_ ? dim_feature_ - k : chunkSize_;
+          sum += pSadKernel_( feature1 + k, feature2 + k, len );
+        }
+        return sum;
+      }
+
+    public: /* attributes */
+
+      /**
+       * @brief the feature vectors (not owned)
+       */
+      const uint8_t * feature_vectors_;
+
+      /**
+       * @brief number of feature vectors
+       */
+      int num_features_;
+
+      /**
+       * @brief dimension of one feature vector
+       */
+      int dim_feature_;
+
+      /**
+       * @brief SAD kernel used for all distance computations
+       */
+      cSadKernel::tSadFunction pSadKernel_;
+
+      /**
+       * @brief all nodes, vecNodes_[0] is the root
+       */
+      std::vector<tNode> vecNodes_;
+
+      /**
+       * @brief feature vector indices, leaves reference ranges of it
+       */
+      std::vector<int> vecIndices_;
+
+      /**
+       * @brief maximal number of feature vectors in a leaf
+       */
+      static const int leafSize_ = 8;
+
+      /**
+       * @brief granularity (in dimensions) of the bounded distance computation
+       */
+      static const int chunkSize_ = 384;
+
+  };
+}
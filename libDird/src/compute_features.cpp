@@ -40,6 +40,9 @@ Street, Fifth Floor, Boston, MA 02110-1301, USA
 #include <string>
 #include <vector>
 #include <fstream>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
 
 #if _MSC_VER <= 1500
 typedef unsigned char uint8_t;
@@ -54,10 +57,87 @@ typedef unsigned char uint8_t;
 #endif
 
 #include "cDird.h"
-#include "cImage.h"
+#include "cImagePrefetcher.h"
+#include "cDownsampler.h"
+#include "cFeatureStore.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
+// result of the extraction of one frame (see extractFrame())
+enum eFrameStatus
+{
+  FRAME_OK,
+  FRAME_READ_FAILED,
+  FRAME_PROCESS_FAILED,
+  FRAME_EXTRACTION_FAILED
+};
+
+// name of file i of a sequence (e.g. dir/000042.png)
+static string fileName( const string & dir, int i, const char * extension )
+{
+  const int bufSize = 256;
+  char base_name[bufSize];
+
+#ifdef _MSC_VER
+  sprintf_s(base_name, bufSize, "%06d.%s", i, extension);
+#else
+  sprintf(base_name, "%06d.%s", i, extension);
+#endif
+
+  return dir + "/" + base_name;
+}
+
+// down samples a loaded image and computes its feature vector (iFrameDim_ values)
+static eFrameStatus extractFrame( const DIRD::cImagePrefetcher::tImage & image, DIRD::cDownsampler & downsampler, DIRD::cDird & dird, uint8_t * frame_feature )
+{
+  if (!image.valid)
+  {
+    return FRAME_READ_FAILED;
+  }
+
+  // down sample the image straight into the integral image of the DIRD extractor
+  // and initialize the extractor
+  if (!downsampler.process( image.view.data, image.view.pitch, image.view.width, image.view.height, NULL, dird.img_integral ) ||
+    !dird.processIntegralImage())
+  {
+    return FRAME_PROCESS_FAILED;
+  }
+
+  // compute the DIRD features of all tiles
+  if (!dird.getGrid( frame_feature ))
+  {
+    return FRAME_EXTRACTION_FAILED;
+  }
+
+  return FRAME_OK;
+}
+
+// the text format of a feature vector: values separated (and terminated) by spaces
+static void formatFeature( const uint8_t * feature, int dim, string & text )
+{
+  text.resize( 4 * dim );
+  char * out = &text[0];
+  for (int d = 0; d < dim; ++d)
+  {
+    int value = feature[d];
+    if (value >= 100)
+    {
+      *out++ = (char)('0' + value / 100);
+    }
+    if (value >= 10)
+    {
+      *out++ = (char)('0' + value / 10 % 10);
+    }
+    *out++ = (char)('0' + value % 10);
+    *out++ = ' ';
+  }
+  text.resize( out - &text[0] );
+}
+
 /*
  * This file computes DIRD features for every image of the input sequence.
  * Feature vectors will be stored in human readable form in text files 
@@ -81,7 +161,7 @@ int main (int argc, char** argv)
     cout << "./compute_loops can be run on this feature folder to compute loop closures.        \n";
     cout << "                                                                                   \n";
     cout << "                                                                                   \n";
-    cout << "\33[1mUsage\33[0m:\n  ./compute_features <path/to/image_sequence> <path/to/feature_folder>\n";
+    cout << "\33[1mUsage\33[0m:\n  ./compute_features <path/to/image_sequence> <path/to/feature_folder|path/to/features.dird> [num_threads=0] [prefetch=0] [sampling=nearest]\n";
     cout << "                                                                                   \n";
     cout << "                                                                                   \n";
     cout << "  \33[1m<path/to/image_sequence> \33[0m                                            \n";
@@ -120,6 +200,32 @@ int main (int argc, char** argv)
     cout << "                                                                                   \n";
     cout << "    Files contain 3456 dimensional DIRD based features in human readable ASCII format.\n";
     cout << "                                                                                   \n";
+    cout << "    If the name ends with .dird a single binary feature store is written instead   \n";
+    cout << "    of a folder of text files. ./compute_loops loads it much faster.               \n";
+    cout << "    An existing store is continued after its last intact frame, e.g. after a crash.\n";
+    cout << "    It can be followed by ./follow_loops while it is being written.                \n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "  \33[1m[num_threads]\33[0m                                                               \n";
+    cout << "                                                                                   \n";
+    cout << "    Number of threads extracting features (each one loads and processes whole images).\n";
+    cout << "    The value is optional and its default is 0 (one thread per core).\n";
+    cout << "    Results do not depend on the number of threads.\n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "  \33[1m[prefetch]\33[0m                                                                  \n";
+    cout << "                                                                                   \n";
+    cout << "    Number of images decoded ahead by two background threads while features are   \n";
+    cout << "    extracted. It bounds the memory held by decoded images. The value is optional \n";
+    cout << "    and its default is 0 (as many images as are extracted at a time).             \n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "  \33[1m[sampling]\33[0m                                                                  \n";
+    cout << "                                                                                   \n";
+    cout << "    How images are down sampled to 192x192 pixels: nearest (default) picks one     \n";
+    cout << "    pixel, area averages all pixels and avoids aliasing. The features of both      \n";
+    cout << "    differ and must not be compared with each other.                               \n";
+    cout << "                                                                                   \n";
     cout << "                                                                                   \n";
     cout << "\33[1mExample\33[0m:\n  ./compute_features path/to/threefold/image_0 path/to/threefold/features\n";
     cout << "\n";
@@ -129,145 +235,247 @@ int main (int argc, char** argv)
 
   int num_images = 100000;
 
-  // IMPORTANT: if you change the values below then the parameters
-  // of the logistic function in cPlaceRecognizer.cpp need to be adjusted!
+  int num_threads = 0;
+  if (argc>=4)
+  {
+    num_threads = atoi(argv[3]);
+  }
+#ifdef _OPENMP
+  if (num_threads <= 0)
+  {
+    num_threads = omp_get_max_threads();
+  }
+#else
+  num_threads = 1;
+#endif
+
+  // Frames are extracted in batches, a few per thread
+  int batch_size = 4 * num_threads;
+
+  int prefetch = 0;
+  if (argc>=5)
+  {
+    prefetch = atoi(argv[4]);
+  }
+  if (prefetch <= 0)
+  {
+    prefetch = batch_size;
+  }
+
+  DIRD::cDownsampler::eMode sampling = DIRD::cDownsampler::NEAREST;
+  if (argc>=6)
+  {
+    string sampling_name = argv[5];
+    if (sampling_name == "area")
+    {
+      sampling = DIRD::cDownsampler::AREA;
+    }
+    else if (sampling_name != "nearest")
+    {
+      cerr << "Unknown sampling " << sampling_name << " (nearest or area)\n";
+      return 1;
+    }
+  }
+
+  // the geometry of the descriptor is defined by DIRD::cDird
+  // IMPORTANT: if you change it then the parameters of the logistic 
+  // function in cPlaceRecognizer.cpp need to be adjusted!
 
   // number of pixels for one tile
-  int tile_size = 48;
+  int tile_size = DIRD::cDird::tileSize_;
   // number of tiles horizontally
-  int num_tiles_hor = 4;
+  int num_tiles_hor = DIRD::cDird::numTilesX_;
   // number of tiles vertically
-  int num_tiles_ver = 4;
+  int num_tiles_ver = DIRD::cDird::numTilesY_;
 
   // dimension of down-sampled image
-  int width_down = tile_size * num_tiles_hor;
-  int height_down = tile_size * num_tiles_ver;
-  uint8_t* img_data  = new uint8_t[ width_down * height_down ];
-  DIRD::cDird dird( width_down, height_down );
+  int width_down = DIRD::cDird::iFrameWidth_;
+  int height_down = DIRD::cDird::iFrameHeight_;
+
+  // one extractor and down sampler per thread
+  vector<DIRD::cDird*> extractors( num_threads );
+  vector<DIRD::cDownsampler*> downsamplers( num_threads );
+  for (int t = 0; t < num_threads; ++t)
+  {
+    extractors[t] = new DIRD::cDird( width_down, height_down );
+    downsamplers[t] = new DIRD::cDownsampler( width_down, height_down, sampling );
+
+    // only the descriptors of the tile centres are needed (see extractFrame())
+    for (int x = 0; x <  num_tiles_hor; ++x)
+    {
+      for (int y = 0; y <  num_tiles_ver; ++y)
+      {
+        extractors[t]->addQueryPoint( x * tile_size + tile_size/2, y * tile_size + tile_size/2 );
+      }
+    }
+  }
 
   // sequence directory
   string img_dir = argv[1];
   string feat_dir = argv[2];
 
-  // loop over all frames 
-  for (int i = 0; i <= num_images; i++) 
+  // binary feature store instead of text files (its destructor finishes the 
+  // file as well, as the loop below ends by failing to read the next image)
+  DIRD::cFeatureStore feature_store;
+  bool use_store = feat_dir.size() > 5 && feat_dir.substr( feat_dir.size() - 5 ) == ".dird";
+  int first_image = 0;
+  if (use_store)
   {
+    FILE * existing_store = fopen( feat_dir.c_str(), "rb" );
+    if (existing_store != NULL)
+    {
+      // continue an interrupted (or finished) run after the last intact frame
+      fclose( existing_store );
+      if (!feature_store.resume( feat_dir, DIRD::cDird::iFrameDim_ ))
+      {
+        cerr << "Couldnt resume feature store " << feat_dir << ". Delete it to start over.\n";
+        return 1;
+      }
+      first_image = feature_store.getNumFeatures();
+      cout << "Resuming feature store " << feat_dir << " at frame " << first_image << "\n";
+    }
+    else if (!feature_store.create( feat_dir, DIRD::cDird::iFrameDim_, num_tiles_hor, num_tiles_ver ))
+    {
+      cerr << "Couldnt create feature store " << feat_dir << "\n";
+      return 1;
+    }
+  }
 
-    // input file names
-    const int bufSize = 256;
-    char base_name[bufSize];
-
-#ifdef _MSC_VER
-    sprintf_s(base_name, bufSize, "%06d.png", i);
-#else
-    sprintf(base_name,"%06d.png",i);
-#endif
-
-    string img_file_name  = img_dir + "/" + base_name;
-
-    // feature file that will be created
-#ifdef _MSC_VER
-    sprintf_s(base_name, bufSize, "%06d.txt",i);
-#else
-    sprintf(base_name,"%06d.txt",i);
-#endif
+  // The images are decoded in the background, the images of a batch plus 
+  // prefetch more ones are held. The threads process the images of a batch
+  // in any order, thereafter the results are written in frame order (and the
+  // first missing image ends the sequence).
+  DIRD::cImagePrefetcher prefetcher( DIRD::cImagePrefetcher::sequence( img_dir, first_image, num_images ), batch_size + prefetch );
+  vector<const DIRD::cImagePrefetcher::tImage*> batch_images( batch_size );
+  vector<uint8_t> batch_features( batch_size * DIRD::cDird::iFrameDim_ );
+  vector<eFrameStatus> batch_status( batch_size );
+  vector<string> batch_text( batch_size );
+  vector<double> batch_time( batch_size );
 
-    string feature_file_name  = feat_dir + "/" + base_name;
+  // loop over all frames 
+  for (int first = first_image; first <= num_images; first += batch_size) 
+  {
+    int num_frames = min( batch_size, num_images - first + 1 );
 
-    // catch image read/write errors here
-    try 
+    // the images of the batch (up to the first missing one)
+    for (int b = 0; b < num_frames; ++b)
     {
+      batch_images[b] = &prefetcher.get( first - first_image + b );
+      if (!batch_images[b]->valid)
+      {
+        num_frames = b + 1;
+      }
+    }
 
-      // load input image
-      DIRD::cImage image(img_file_name);
-      cout << "\rComputing feature for " << img_file_name;
-
-      // image dimensions
-      int width  = image.getWidth();
-      int height = image.getHeight();
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (int b = 0; b < num_frames; ++b)
+    {
+      int thread = 0;
+#ifdef _OPENMP
+      thread = omp_get_thread_num();
+#endif
 
-      // compute scaling factors for down sampling
-      float scale_hor = ((float)width) / ((float) width_down );
-      float scale_ver = ((float)height) / ((float) height_down );
+#ifdef TIMING
+      struct timeval TIME;    
+      gettimeofday(&TIME, NULL);    
+      double TIME_START = TIME.tv_sec + ((double) TIME.tv_usec)/1000000.0;
+#endif
 
-      // down sample the image
-      int k = 0;
-      for (int v = 0; v < height_down; v++) 
+      uint8_t * frame_feature = &batch_features[ b * DIRD::cDird::iFrameDim_ ];
+      batch_status[b] = extractFrame( *batch_images[b], *downsamplers[thread], *extractors[thread], frame_feature );
+      if (batch_status[b] == FRAME_OK && !use_store)
       {
-        for (int u = 0; u < width_down; u++) 
-        {
-          int uu = (int)(((float)u) * scale_hor);
-          int vv = (int)(((float)v) * scale_ver);
-          image.getPixel( uu, vv, img_data[k] );
-          k++;
-        }
+        formatFeature( frame_feature, DIRD::cDird::iFrameDim_, batch_text[b] );
       }
 
 #ifdef TIMING
-      struct timeval TIME;    
       gettimeofday(&TIME, NULL);    
-      double TIME_START = TIME.tv_sec + ((double) TIME.tv_usec)/1000000.0;
+      batch_time[b] = TIME.tv_sec + ((double) TIME.tv_usec)/1000000.0 - TIME_START;
 #endif
+    }
 
-      // initialize the DIRD extractor
-      if (!dird.process( img_data ))
+    for (int b = 0; b < num_frames; ++b)
+    {
+      prefetcher.release();
+    }
+
+    // write the results in frame order
+    for (int b = 0; b < num_frames; ++b)
+    {
+      // input file name and feature file that will be created
+      string img_file_name = fileName( img_dir, first + b, "png" );
+      string feature_file_name = fileName( feat_dir, first + b, "txt" );
+
+      if (batch_status[b] == FRAME_READ_FAILED)
+      {
+        cout << "\nWaited " << prefetcher.getWaitTime() << " s for images to be loaded";
+        cerr << "\nERROR: Couldn't read input files " << img_file_name << endl;
+        return 1;
+      }
+      cout << "\rComputing feature for " << img_file_name;
+
+      if (batch_status[b] == FRAME_PROCESS_FAILED)
       {
         cerr << "Couldnt pre-process image for DIRD extraction\n";
+        if (use_store)
+        {
+          // frames of a store must not be skipped
+          return 1;
+        }
         continue;
       }
 
-
-      // loop over tiles and compute DIRD feature
-      ofstream feature_file;
-      feature_file.open(feature_file_name.c_str());
-      if (!feature_file.is_open())
+      if (batch_status[b] == FRAME_EXTRACTION_FAILED)
       {
-        cerr << "Couldnt create file " << feature_file_name << ". Does feature directory exist?\n";
+        cerr << "Couldn't extract DIRD features of the tiles of " << img_file_name << "\n";
+        if (use_store)
+        {
+          return 1;
+        }
         continue;
       }
 
-      vector<uint8_t> feature_vector;
-      for (int x = 0; x <  num_tiles_hor; ++x)
+      // dump the features to file
+      if (!use_store)
       {
-        for (int y = 0; y <  num_tiles_ver; ++y)
+        ofstream feature_file(feature_file_name.c_str());
+        if (!feature_file.is_open())
         {
-          // compute DIRD feature ... 
-          if (!dird.get(x * tile_size + tile_size/2, y * tile_size + tile_size/2, feature_vector))
-          {
-            cerr << "Couldn't extract DIRD feature for pixel position " << x * tile_size + tile_size/2 << " " <<  y * tile_size + tile_size/2 << "\n";
-            cerr << "Writing nothing to feature file " << feature_file_name << "! Re-run compute_features\n";
-            feature_file.close();
-            continue;
-          }
-          // ... and dump to file
-          for (int d = 0; d < dird.iDim_; ++d)
-          {
-            feature_file << (int)feature_vector[d] << " ";
-          }
+          cerr << "Couldnt create file " << feature_file_name << ". Does feature directory exist?\n";
+          continue;
         }
+        feature_file << batch_text[b];
+        feature_file.close();
+      }
+
+      if (use_store && !feature_store.append( &batch_features[ b * DIRD::cDird::iFrameDim_ ] ))
+      {
+        cerr << "Couldnt write to feature store " << feat_dir << "\n";
+        return 1;
       }
-      feature_file.close();
 
 #ifdef TIMING
-      gettimeofday(&TIME, NULL);    
-      double TIME_END = TIME.tv_sec + ((double) TIME.tv_usec)/1000000.0;
-      cout << "\nTime in [ms]: " << (TIME_END - TIME_START) * 1000 << "\n";
+      cout << "\nTime in [ms]: " << batch_time[b] * 1000 << "\n";
 #endif
-
-    } 
-    catch (...) 
-    {
-      cerr << "\nERROR: Couldn't read input files " << img_file_name << endl;
-      return 1;
     }
+  }
 
+  if (use_store && !feature_store.finish())
+  {
+    cerr << "Couldnt write to feature store " << feat_dir << "\n";
+    return 1;
   }
 
   // output
+  cout << "\nWaited " << prefetcher.getWaitTime() << " s for images to be loaded";
   cout << "\nDIRD extraction complete! Exiting ..." << endl;
 
   // exit
-  delete [] img_data;
+  for (int t = 0; t < num_threads; ++t)
+  {
+    delete extractors[t];
+    delete downsamplers[t];
+  }
   return 0;
 }
 
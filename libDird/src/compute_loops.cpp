@@ -48,16 +48,17 @@ typedef unsigned char uint8_t;
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sstream>
 #include <fstream>
 
 #include "cImage.h"
 #include "cDird.h"
 #include "cPlaceRecognizer.h"
+#include "cFeatureStore.h"
 
 using namespace std;
 
-bool loadFeatureFromFile( string fileName, uint8_t * feature, int dim );
 void saveToPng( uint8_t * img, int img_size, string fileName );
 
 /*
@@ -83,7 +84,7 @@ int main (int argc, char** argv)
     cout << "The finally detected loop closures are stored in the matrix \"loops\".\n";
     cout << "                                                                                   \n";
     cout << "                                                                                   \n";
-    cout << "\33[1mUsage\33[0m:\n  ./compute_loops  <path/to/feature_folder>  <path/to/matrix_folder> [size_of_matrix_image=1200]\n";
+    cout << "\33[1mUsage\33[0m:\n  ./compute_loops  <path/to/feature_folder|path/to/features.dird>  <path/to/matrix_folder> [size_of_matrix_image=1200] [num_threads=0] [segment_engine=banded]\n";
     cout << "                                                                                   \n";
     cout << "                                                                                   \n";
     cout << "  \33[1m<path/to/feature_folder> \33[0m                                                \n";
@@ -103,6 +104,9 @@ int main (int argc, char** argv)
     cout << "                                                                                   \n";
     cout << "    Files contain 3456 dimensional DIRD based features in human readable ASCII format.\n";
     cout << "                                                                                   \n";
+    cout << "    Alternatively a binary feature store (written by ./compute_features or         \n";
+    cout << "    ./convert_features) can be given. It is memory mapped, which is much faster.   \n";
+    cout << "                                                                                   \n";
     cout << "                                                                                   \n";
     cout << "  \33[1m<path/to/matrix_folder> \33[0m                                               \n";
     cout << "                                                                                   \n";
@@ -130,6 +134,21 @@ int main (int argc, char** argv)
     cout << "    A sensible value seems something like num_features/4 or so.\n";
     cout << "                                                                                   \n";
     cout << "                                                                                   \n";
+    cout << "  \33[1m[num_threads]\33[0m                                                               \n";
+    cout << "                                                                                   \n";
+    cout << "    Number of threads used to compute the pairwise similarities.\n";
+    cout << "    The value is optional and its default is 0 (one thread per core).\n";
+    cout << "    Results do not depend on the number of threads.\n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "  \33[1m[segment_engine]\33[0m                                                            \n";
+    cout << "                                                                                   \n";
+    cout << "    How segments of similar places are matched: banded (default) runs one dynamic  \n";
+    cout << "    programming per hypothesis, sweep one pass over the whole matrix (faster on    \n";
+    cout << "    dense loops, scores differ by float rounding), validate runs banded and reports\n";
+    cout << "    the differences of sweep to it.                                                \n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
     cout << "                                                                                   \n";
     cout << "\33[1mExample\33[0m:\n  ./compute_loops path/to/threefold/features path/to/threefold/matrices\n";
     cout << "\n";
@@ -146,6 +165,31 @@ int main (int argc, char** argv)
     img_size = atoi(argv[3]);
   }
 
+  int num_threads = 0;
+  if (argc>=5)
+  {
+    num_threads = atoi(argv[4]);
+  }
+
+  DIRD::cPlaceRecognizer::eSegmentEngine segment_engine = DIRD::cPlaceRecognizer::SEGMENT_BANDED;
+  if (argc>=6)
+  {
+    string engine_name = argv[5];
+    if (engine_name == "sweep")
+    {
+      segment_engine = DIRD::cPlaceRecognizer::SEGMENT_SWEEP;
+    }
+    else if (engine_name == "validate")
+    {
+      segment_engine = DIRD::cPlaceRecognizer::SEGMENT_VALIDATE;
+    }
+    else if (engine_name != "banded")
+    {
+      cerr << "Unknown segment engine " << engine_name << " (banded, sweep or validate)\n";
+      return 1;
+    }
+  }
+
   // sequence directory
   string dir = argv[1];
   string dump_dir = argv[2];
@@ -153,41 +197,59 @@ int main (int argc, char** argv)
 
   // allocate some memory large enough to hold all feature vectors
   static const int max_num_features = 100000; // adjust to your needs
-  static const int dim_feature = DIRD::cDird::iDim_ * 16 /* assuming a tiling of 4x4 */; 
-  uint8_t * feature_vectors = (uint8_t*)_mm_malloc(sizeof(uint8_t) *  max_num_features * dim_feature, 16); 
+  static const int dim_feature = DIRD::cDird::iFrameDim_; 
+  uint8_t * feature_vectors = NULL;
 
-  // loop over all features and load them from disk
-  cout << "Loading features from disk:" << "\n";
-  for (int i = 0; i <= num_features; i++) 
+  // a binary feature store is memory mapped and used in place
+  DIRD::cFeatureStore feature_store;
+  if (feature_store.open( dir ))
   {
-
-    // input file names
-    char base_name[256]; 
-
-#ifdef _MSC_VER
-    sprintf_s(base_name, 256, "%06d.txt",i);
-#else
-	sprintf(base_name,"%06d.txt",i);
-#endif
-
-    string feature_file_name  = dir + "/" + base_name;
-    cout << "\rLoading feature " << feature_file_name;
-
-    // load feature vector from file
-    if (!loadFeatureFromFile( feature_file_name, &feature_vectors[ i * dim_feature ], dim_feature ))
+    if (feature_store.getDimFeature() != dim_feature)
     {
-      cerr << "\nError reading feature from file " << feature_file_name << ". Does file exist?\n";
-      break;
+      cerr << "Feature store " << dir << " contains " << feature_store.getDimFeature() 
+        << " dimensional features, expected " << dim_feature << ". Exiting.\n";
+      return 1;
     }
+    num_features = feature_store.getNumFeatures();
+    cout << "Mapped " << num_features << " features from " << dir;
 
-    num_features = i + 1;
+    if (feature_store.isContiguous())
+    {
+      // cPlaceRecognizer only reads the feature vectors
+      feature_vectors = const_cast<uint8_t*>( feature_store.getFeature(0) );
+    }
+    else
+    {
+      // padded records need to be packed
+      feature_vectors = (uint8_t*)_mm_malloc(sizeof(uint8_t) * (size_t)num_features * dim_feature, 16);
+      for (int i = 0; i < num_features; i++)
+      {
+        memcpy( &feature_vectors[ (size_t)i * dim_feature ], feature_store.getFeature(i), dim_feature );
+      }
+    }
+  }
+  else
+  {
+    feature_vectors = (uint8_t*)_mm_malloc(sizeof(uint8_t) * (size_t)max_num_features * dim_feature, 16); 
 
+    // load all features from disk (in parallel, until the first missing file)
+    cout << "Loading features from disk:" << "\n";
+    num_features = DIRD::cFeatureStore::loadTextFolder( dir, feature_vectors, max_num_features, dim_feature, num_threads );
   }
 
   cout << "\n";
 
+  // make sure the runtime dispatched SAD kernels agree with each other
+  if (!DIRD::cSadKernel::selfTest())
+  {
+    cerr << "SAD kernel self test failed. Exiting.\n";
+    return 1;
+  }
+
   // compute loop closures
   DIRD::cPlaceRecognizer place_recognizer( feature_vectors, num_features, dim_feature );
+  place_recognizer.numThreads_ = num_threads;
+  place_recognizer.segmentEngine_ = segment_engine;
   if (!place_recognizer.computePairwiseSimilarity( 200 ))
   {
     cerr << "Computing pairwise similarities failed. Exiting.\n";
@@ -260,7 +322,10 @@ int main (int argc, char** argv)
 
   // exit
   delete [] img;
-  _mm_free(feature_vectors);
+  if (feature_vectors != feature_store.getFeature(0))
+  {
+    _mm_free(feature_vectors);
+  }
   return 0;
 }
 
@@ -284,35 +349,3 @@ void saveToPng( uint8_t * img, int img_size, string fileName )
   }
   image.write(fileName);
 }
-
-bool loadFeatureFromFile( string fileName, uint8_t * feature, int dim )
-{
-
-  ifstream file( fileName.c_str() );
-  if (!file.is_open())
-  {
-    return false;
-  }
-
-  string word,line;
-  getline (file,line);
-  istringstream iss(line, istringstream::in);
-  for (int i = 0; i < dim; ++i)
-  {
-    iss >> word;
-    int v = atoi(word.c_str());
-    if (v < 0 || v > 255)
-    {
-      cerr << "Trying to load a feature vector which is not uint8_t\n";
-      return false;
-    }
-    feature[i] = (uint8_t) v;
-    if (!iss.good())
-    {
-      cerr << "Trying to load a feature vector which is lower dimensional than " << dim << "\n";
-      return false;
-    }
-  }
-
-  return true;
-}
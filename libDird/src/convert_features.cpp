@@ -0,0 +1,146 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA 
+*/
+
+/*
+ 
+   If you use this code for your research we kindly ask you 
+   to cite the following article.
+
+  @inproceedings{lategahn2013HowTo,
+    Address = {Gold Coast, Australia},
+    Author = {Henning Lategahn and Johannes Beck and Bernd Kitt and Christoph Stiller},
+    Booktitle = {IEEE Intelligent Vehicles Symposium},
+    Title = {How to Learn an Illumination Robust Image Feature for Place Recognition (submitted)},
+    Year = {2013}}
+
+*/
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if _MSC_VER <= 1500
+typedef unsigned char uint8_t;
+#else
+#include <stdint.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cDird.h"
+#include "cFeatureStore.h"
+
+using namespace std;
+
+/*
+ * Converts a folder of feature vectors in text format (as written by older
+ * versions of compute_features) into a single binary feature store which
+ * compute_loops can memory map.
+ *
+ */
+int main (int argc, char** argv) 
+{
+
+  if (argc<3) 
+  {
+    cout << "\n\n";
+    cout << "A folder of feature vectors in text format is converted into a binary feature store.\n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "\33[1mUsage\33[0m:\n  ./convert_features <path/to/feature_folder> <path/to/features.dird>\n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "  \33[1m<path/to/feature_folder> \33[0m                                                \n";
+    cout << "                                                                                   \n";
+    cout << "    A folder containing text files 000000.txt, 000001.txt, ... with one 3456       \n";
+    cout << "    dimensional feature vector each (written by ./compute_features).               \n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "  \33[1m<path/to/features.dird> \33[0m                                                 \n";
+    cout << "                                                                                   \n";
+    cout << "    The binary feature store that will be created. It can be passed to             \n";
+    cout << "    ./compute_loops instead of the feature folder.                                 \n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "\33[1mExample\33[0m:\n  ./convert_features path/to/threefold/features path/to/threefold/features.dird\n";
+    cout << "\n";
+    return 1;
+  }
+
+  string dir = argv[1];
+  string store_file_name = argv[2];
+
+  static const int max_num_features = 100000;
+  static const int dim_feature = DIRD::cDird::iFrameDim_; 
+  vector<uint8_t> feature_vector( dim_feature );
+  vector<char> buffer;
+
+  DIRD::cFeatureStore feature_store;
+  if (!feature_store.create( store_file_name, dim_feature, DIRD::cDird::numTilesX_, DIRD::cDird::numTilesY_ ))
+  {
+    cerr << "Couldnt create feature store " << store_file_name << "\n";
+    return 1;
+  }
+
+  // loop over all features until the first missing file
+  int num_features = 0;
+  for (int i = 0; i < max_num_features; i++) 
+  {
+    char base_name[256]; 
+#ifdef _MSC_VER
+    sprintf_s(base_name, 256, "%06d.txt",i);
+#else
+    sprintf(base_name,"%06d.txt",i);
+#endif
+
+    string feature_file_name  = dir + "/" + base_name;
+    if (!DIRD::cFeatureStore::loadTextFeature( feature_file_name, &feature_vector[0], dim_feature, &buffer ))
+    {
+      break;
+    }
+    if (!feature_store.append( &feature_vector[0] ))
+    {
+      cerr << "\nCouldnt write to feature store " << store_file_name << "\n";
+      return 1;
+    }
+    num_features = i + 1;
+
+    if (i % 100 == 0)
+    {
+      cout << "\rConverting feature " << feature_file_name;
+      cout.flush();
+    }
+  }
+
+  if (!feature_store.finish())
+  {
+    cerr << "\nCouldnt write to feature store " << store_file_name << "\n";
+    return 1;
+  }
+
+  cout << "\nConverted " << num_features << " features to " << store_file_name << "\n";
+  return 0;
+}
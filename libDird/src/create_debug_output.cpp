@@ -45,12 +45,12 @@ typedef unsigned char uint8_t;
 #endif
 
 #include "cImage.h"
+#include "cImagePrefetcher.h"
 #include "cPlaceRecognizer.h"
 
 using namespace std;
 void saveToPng( uint8_t * img, int width, int height, string fileName );
 typedef DIRD::cPlaceRecognizer::tSparseMatrix tSparseMatrix;
-typedef DIRD::cPlaceRecognizer::tSparseMatrixIterator tSparseMatrixIterator;
 
 int main (int argc, char** argv) 
 {
@@ -121,83 +121,92 @@ cout << "\n\n";
   int num_loops = matrix.size();
   int iCounter = 0;
 
+  // the loops row by row and the pairs of input images in their order, they
+  // are decoded in the background while the previous debug images are written
+  vector< pair<int,int> > loops;
+  vector<string> img_file_names;
+  for (int i = 0; i < matrix.size_; ++i)
+  {
+    for (const tSparseMatrix::tEntry * entry = matrix.rowBegin(i); entry != matrix.rowEnd(i); ++entry)
+    {
+      loops.push_back( make_pair( i, entry->j ) );
+      img_file_names.push_back( DIRD::cImagePrefetcher::fileName( img_dir, i ) );
+      img_file_names.push_back( DIRD::cImagePrefetcher::fileName( img_dir, entry->j ) );
+    }
+  }
+  DIRD::cImagePrefetcher prefetcher( img_file_names );
+
+  // down sampled and concatinated images
+  uint8_t* img_data  = new uint8_t[ width_down * height_down * 2];
+
   // loop over all non-zero entries
-  for (tSparseMatrixIterator iter = matrix.begin(); 
-      iter != matrix.end(); 
-      iter++)
+  for (int l = 0, n = 0; l < num_loops; ++l, n += 2)
   {
 
-    // compute 2d index
-    int j = iter->first % matrix.size_;
-    int i = (iter->first - j) / matrix.size_;
+    // 2d index
+    int i = loops[l].first;
+    int j = loops[l].second;
 
-    // input file names
+    // output file name
     const int bufSize = 256;
     char base_name[bufSize]; 
 
-#ifdef _MSC_VER
-    sprintf_s(base_name, bufSize, "%06d.png",i);
-#else
-    sprintf(base_name,"%06d.png",i);
-#endif
-    string img_file_name1  = img_dir + "/" + base_name;
-
-#ifdef _MSC_VER
-    sprintf_s(base_name, bufSize, "%06d.png",j);
-#else
-    sprintf(base_name,"%06d.png",j);
-#endif
-    string img_file_name2  = img_dir + "/" + base_name;
-
 #ifdef _MSC_VER
     sprintf_s(base_name, bufSize, "%06d_%06d.png",i,j);
 #else
     sprintf(base_name,"%06d_%06d.png",i,j);
 #endif
 
-    try 
-    {
+    // input images
+    const DIRD::cImagePrefetcher::tImage & image1 = prefetcher.get( n );
+    const DIRD::cImagePrefetcher::tImage & image2 = prefetcher.get( n + 1 );
 
-      // load input image
-      DIRD::cImage image1(img_file_name1);
-      DIRD::cImage image2(img_file_name2);
+    bool valid = image1.valid && image2.valid;
+    if (valid)
+    {
 
       // image dimensions
-      int width  = image1.getWidth();
-      int height = image2.getHeight();
+      int width  = image1.view.width;
+      int height = image2.view.height;
 
       // compute scaling factors for down sampling
       float scale_hor = ((float)width) / ((float) width_down );
       float scale_ver = ((float)height) / ((float) height_down );
 
       // down sample and concatinate the image
-      uint8_t* img_data  = new uint8_t[ width_down * height_down * 2];
       int k = 0;
       for (int v = 0; v < height_down; v++) 
       {
+        int vv = (int)(((float)v) * scale_ver);
+        const uint8_t * row1 = image1.view.row( vv );
+        const uint8_t * row2 = image2.view.row( vv );
         for (int u = 0; u < width_down; u++) 
         {
           int uu = (int)(((float)u) * scale_hor);
-          int vv = (int)(((float)v) * scale_ver);
 
-          image1.getPixel( uu, vv, img_data[k] );
-          image2.getPixel( uu, vv, img_data[k + width_down * height_down ]);
+          img_data[k] = row1[uu];
+          img_data[k + width_down * height_down ] = row2[uu];
           k++;
         }
       }
-
-      string file_out = dump_dir + "/" + string(base_name);
-      cout << "Saving " << file_out << " (" <<  iCounter++ << " of " << num_loops << ")\n";
-      saveToPng( img_data, width_down, height_down * 2, file_out);
-
     }
-    catch (...) 
+    prefetcher.release();
+    prefetcher.release();
+
+    if (!valid)
     {
-      cerr << "\nERROR: Processing files " << img_file_name1 << " or " <<  img_file_name2 << endl;
+      cerr << "\nERROR: Processing files " << img_file_names[n] << " or " <<  img_file_names[n + 1] << endl;
       continue;
     }
 
+    string file_out = dump_dir + "/" + string(base_name);
+    cout << "Saving " << file_out << " (" <<  iCounter++ << " of " << num_loops << ")\n";
+    saveToPng( img_data, width_down, height_down * 2, file_out);
+
   }
+  delete [] img_data;
+
+  cout << "\nWaited " << prefetcher.getWaitTime() << " s for images to be loaded";
 
   // output
   cout << "\nDone creating debug output! Exiting ..." << endl;
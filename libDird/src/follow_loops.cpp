@@ -0,0 +1,165 @@
+/*
+Copyright 2012. All rights reserved.
+Institute of Measurement and Control Systems
+Karlsruhe Institute of Technology, Germany
+
+This file is part of libDird.
+Authors: Henning Lategahn
+         Johannes Beck
+         Bernd Kitt
+Website: http://www.mrt.kit.edu/libDird.php
+
+libDird is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or any later version.
+
+libDird is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+libDird; if not, write to the Free Software Foundation, Inc., 51 Franklin
+Street, Fifth Floor, Boston, MA 02110-1301, USA 
+*/
+
+/*
+ 
+   If you use this code for your research we kindly ask you 
+   to cite the following article.
+
+  @inproceedings{lategahn2013HowTo,
+    Address = {Gold Coast, Australia},
+    Author = {Henning Lategahn and Johannes Beck and Bernd Kitt and Christoph Stiller},
+    Booktitle = {IEEE Intelligent Vehicles Symposium},
+    Title = {How to Learn an Illumination Robust Image Feature for Place Recognition (submitted)},
+    Year = {2013}}
+
+*/
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if _MSC_VER <= 1500
+typedef unsigned char uint8_t;
+#else
+#include <stdint.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _MSC_VER
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "cDird.h"
+#include "cFeatureStore.h"
+#include "cOnlinePlaceRecognizer.h"
+
+using namespace std;
+
+/*
+ * Follows a feature store while ./compute_features is still writing it and
+ * reports loop closures as soon as they are confirmed (see
+ * cOnlinePlaceRecognizer). Feature extraction and loop closure detection
+ * thus run at the same time.
+ *
+ */
+int main (int argc, char** argv) 
+{
+
+  if (argc<2) 
+  {
+    cout << "\n\n";
+    cout << "Loop closures are detected online while a feature store is being written.        \n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "\33[1mUsage\33[0m:\n  ./follow_loops <path/to/features.dird> [poll_interval_ms=200]\n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "  \33[1m<path/to/features.dird> \33[0m                                                 \n";
+    cout << "                                                                                   \n";
+    cout << "    A feature store written by ./compute_features (possibly still running).       \n";
+    cout << "    Every confirmed loop closure is printed as \"<frame_i> <frame_j> <score>\".    \n";
+    cout << "    The program exits once the store is complete.                                 \n";
+    cout << "                                                                                   \n";
+    cout << "                                                                                   \n";
+    cout << "\33[1mExample\33[0m:\n  ./compute_features path/to/threefold/image_0 path/to/threefold/features.dird &\n";
+    cout << "  ./follow_loops path/to/threefold/features.dird\n";
+    cout << "\n";
+    return 1;
+  }
+
+  string store_file_name = argv[1];
+  int poll_interval = argc >= 3 ? atoi(argv[2]) : 200;
+
+  static const int dim_feature = DIRD::cDird::iFrameDim_; 
+  DIRD::cOnlinePlaceRecognizer place_recognizer( dim_feature, 200, 20, 60 );
+  vector<DIRD::cOnlinePlaceRecognizer::tLoopClosure> loop_closures;
+
+  // wait for the store to appear
+  DIRD::cFeatureStore feature_store;
+  while (!feature_store.open( store_file_name ))
+  {
+#ifdef _MSC_VER
+    Sleep( poll_interval );
+#else
+    usleep( poll_interval * 1000 );
+#endif
+  }
+  if (feature_store.getDimFeature() != dim_feature)
+  {
+    cerr << "Feature store " << store_file_name << " contains " << feature_store.getDimFeature() 
+      << " dimensional features, expected " << dim_feature << ". Exiting.\n";
+    return 1;
+  }
+
+  while (true)
+  {
+    // feed all frames which arrived in the meantime
+    bool complete = feature_store.header_.complete != 0;
+    for (int i = place_recognizer.getNumFrames(); i < feature_store.getNumFeatures(); ++i)
+    {
+      place_recognizer.addFrame( feature_store.getFeature(i), loop_closures );
+    }
+    if (complete)
+    {
+      place_recognizer.flush( loop_closures );
+    }
+
+    for (size_t l = 0; l < loop_closures.size(); ++l)
+    {
+      cout << loop_closures[l].i << " " << loop_closures[l].j << " " << loop_closures[l].score << "\n";
+    }
+    cout.flush();
+    loop_closures.clear();
+
+    if (complete)
+    {
+      break;
+    }
+
+#ifdef _MSC_VER
+    Sleep( poll_interval );
+#else
+    usleep( poll_interval * 1000 );
+#endif
+    if (!feature_store.refresh())
+    {
+      cerr << "Couldnt read feature store " << store_file_name << ". Exiting.\n";
+      return 1;
+    }
+  }
+
+  int num_frames = place_recognizer.getNumFrames();
+  cerr << "Processed " << num_frames << " frames, latency per frame: mean " 
+    << (num_frames > 0 ? place_recognizer.latencySum_ / num_frames * 1000.0 : 0.0) 
+    << " ms, max " << place_recognizer.latencyMax_ * 1000.0 << " ms\n";
+
+  return 0;
+}